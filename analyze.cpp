@@ -0,0 +1,284 @@
+#ifdef _WIN32
+#include <SDKDDKVer.h>
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grading.h"
+#include "recording.h"
+
+class MappedFile {
+public:
+    MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER file_size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            return;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size = data != nullptr ? static_cast<size_t>(file_size.QuadPart) : 0;
+        }
+#else
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0) {
+            return;
+        }
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            auto ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED) {
+                madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data = ptr;
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(const_cast<void*>(data));
+        }
+        if (mapping != NULL) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+#else
+        if (data != nullptr) {
+            munmap(const_cast<void*>(data), size);
+        }
+#endif
+    }
+
+    const void* data = nullptr;
+    size_t size = 0;
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+// Hover intervals (dash button up time) in 100 us buckets up to 100 ms.
+struct SessionStats {
+    static constexpr size_t BUCKETS = 1001;
+    static constexpr int64_t BUCKET_NS = 100000;
+
+    uint64_t edges = 0;
+    uint64_t hovers = 0;
+    std::array<uint64_t, 3> grades{};
+    std::array<uint64_t, BUCKETS> histogram{};
+
+    void Add(const SessionStats& other) {
+        edges += other.edges;
+        hovers += other.hovers;
+        for (size_t i = 0; i < grades.size(); ++i) {
+            grades[i] += other.grades[i];
+        }
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            histogram[i] += other.histogram[i];
+        }
+    }
+
+    double Percentile(double p) const {
+        if (hovers == 0) {
+            return 0.0;
+        }
+        const auto target = static_cast<uint64_t>(p * static_cast<double>(hovers - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            seen += histogram[i];
+            if (seen > target) {
+                return static_cast<double>((i + 1) * BUCKET_NS) / 1e6;
+            }
+        }
+        return static_cast<double>(BUCKETS * BUCKET_NS) / 1e6;
+    }
+
+    void Print(const char* label) const {
+        const auto graded = grades[0] + grades[1] + grades[2];
+        const auto rate = [&](Grade grade) {
+            return graded != 0 ? 100.0 * static_cast<double>(grades[static_cast<int>(grade)]) / static_cast<double>(graded) : 0.0;
+        };
+        std::printf("%s edges=%llu hovers=%llu p50=%.1fms p90=%.1fms p99=%.1fms red=%.1f%% yellow=%.1f%% green=%.1f%%\n",
+            label,
+            static_cast<unsigned long long>(edges),
+            static_cast<unsigned long long>(hovers),
+            Percentile(0.5), Percentile(0.9), Percentile(0.99),
+            rate(Grade::Red), rate(Grade::Yellow), rate(Grade::Green));
+    }
+};
+
+static bool analyze(const std::string& path, SessionStats& stats) {
+    MappedFile file(path);
+    RecordingHeader header;
+    if (!ReadRecordingHeader(file.data, file.size, header)) {
+        return false;
+    }
+
+    const auto records = reinterpret_cast<const uint32_t*>(static_cast<const char*>(file.data) + sizeof(header));
+    const auto count = (file.size - sizeof(header)) / sizeof(uint32_t);
+
+    std::array<Controller::Action, RECORD_DEVICE_TICK> states{};
+    std::array<int64_t, RECORD_DEVICE_TICK> button_times{};
+    int64_t time = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto record = records[i];
+        time += static_cast<int64_t>(RecordDelta(record)) * header.tick_ns;
+
+        const auto device = RecordDevice(record);
+        if (device == RECORD_DEVICE_TICK) {
+            continue;
+        }
+
+        ++stats.edges;
+        const auto state = RecordState(record);
+        if ((state ^ states[device]) & Controller::Action::Dash) {
+            const bool isdown = (states[device] & Controller::Action::Dash) != 0;
+            const auto delta_time = std::chrono::nanoseconds(time - button_times[device]);
+            ++stats.grades[static_cast<int>(GradeDash(isdown, delta_time))];
+            if (!isdown) {
+                const auto bucket = static_cast<size_t>(delta_time.count() / SessionStats::BUCKET_NS);
+                ++stats.histogram[bucket < SessionStats::BUCKETS ? bucket : SessionStats::BUCKETS - 1];
+                ++stats.hovers;
+            }
+            button_times[device] = time;
+        }
+        states[device] = state;
+    }
+
+    return true;
+}
+
+// Each worker owns a deque of file indices, pops from its back and steals
+// from the front of the others once it runs dry.
+class WorkQueues {
+public:
+    WorkQueues(size_t workers, size_t jobs) : queues(workers) {
+        for (size_t i = 0; i < jobs; ++i) {
+            queues[i % workers].jobs.push_back(i);
+        }
+    }
+
+    bool Next(size_t worker, size_t& job) {
+        {
+            auto& own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = own.jobs.back();
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto& victim = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    std::vector<Queue> queues;
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <recording or directory>..." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::error_code error;
+        if (std::filesystem::is_directory(argv[i], error)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[i], error)) {
+                if (entry.is_regular_file()) {
+                    paths.push_back(entry.path().string());
+                }
+            }
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+
+    const size_t workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), paths.size()));
+    WorkQueues queues(workers, paths.size());
+
+    std::mutex output_mutex;
+    SessionStats total;
+    std::atomic<uint64_t> sessions{0};
+    std::atomic<uint64_t> failures{0};
+
+    std::vector<std::thread> threads;
+    for (size_t worker = 0; worker < workers; ++worker) {
+        threads.emplace_back([&, worker] {
+            auto stats = std::make_unique<SessionStats>();
+            SessionStats subtotal;
+            size_t job;
+            while (queues.Next(worker, job)) {
+                *stats = SessionStats{};
+                if (!analyze(paths[job], *stats)) {
+                    std::lock_guard<std::mutex> lock(output_mutex);
+                    std::fprintf(stderr, "%s: not a recording\n", paths[job].c_str());
+                    ++failures;
+                    continue;
+                }
+
+                subtotal.Add(*stats);
+                ++sessions;
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+                stats->Print(paths[job].c_str());
+                std::fflush(stdout);
+            }
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            total.Add(subtotal);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::printf("total sessions=%llu", static_cast<unsigned long long>(sessions.load()));
+    total.Print("");
+    return failures != 0 ? 2 : 0;
+}
@@ -0,0 +1,594 @@
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../binding.h"
+#include "../controller.h"
+#include "../edge_output.h"
+#include "../grading.h"
+#include "../live_stats.h"
+#include "../render.h"
+#include "../sampler.h"
+#include "../sequence.h"
+#include "../sdl.h"
+#include "../spsc_ring.h"
+#include "fake_sdl.h"
+
+// Microbenchmarks of the per-iteration hot paths, run against the in-tree
+// fake libSDL2 so they need neither SDL nor a controller. Every path is
+// paired with the implementation it replaced, tagged "legacy"; faster
+// variants are registered next to them under the same prefix.
+
+#define RED_TEXT "\033[31;1m"
+#define GREEN_TEXT "\033[32;1m"
+#define YELLOW_TEXT "\033[33;1m"
+
+static const char* const GRADE_COLORS[] = {RED_TEXT, YELLOW_TEXT, GREEN_TEXT};
+
+static constexpr int BUTTONS = 16;
+static constexpr Controller::Action ACTIONS[] = {
+    Controller::Action::Dash,
+    Controller::Action::Slash,
+    Controller::Action::Item,
+    Controller::Action::Map,
+    Controller::Action::Menu,
+    Controller::Action::Pause,
+};
+
+using BenchClock = std::chrono::steady_clock;
+
+static volatile uint64_t sink;
+
+struct Benchmark {
+    const char* name;
+    std::function<void()> setup;
+    std::function<uint64_t()> run;
+    std::function<void()> teardown;
+    // Instead of run: measures itself and returns ns per op.
+    std::function<double()> self_timed;
+};
+
+// Doubles the batch size until a batch takes 20 ms, then keeps the best of
+// five batches to filter out scheduling noise.
+static double measure(const std::function<uint64_t()>& run) {
+    const auto batch = [&](uint64_t iterations) {
+        uint64_t acc = 0;
+        const auto start = BenchClock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            acc += run();
+        }
+        const auto elapsed = BenchClock::now() - start;
+        sink = sink + acc;
+        return std::chrono::duration<double, std::nano>(elapsed).count();
+    };
+
+    uint64_t iterations = 1;
+    while (batch(iterations) < 20e6 && iterations < (1ull << 40)) {
+        iterations *= 2;
+    }
+
+    double best = batch(iterations);
+    for (int i = 0; i < 4; ++i) {
+        best = std::min(best, batch(iterations));
+    }
+    return best / static_cast<double>(iterations);
+}
+
+// The SDL controller as it was before the binding tables: a map walked on
+// every poll and a string built on every bind. Symbols are resolved with
+// dlsym() so that calls go through pointers, as they do in SDLLoader.
+class LegacySDLController {
+public:
+    explicit LegacySDLController(int index) {
+        const auto get_sym = [](const char* name, auto& sym_ptr) {
+            sym_ptr = reinterpret_cast<std::remove_reference_t<decltype(sym_ptr)>>(dlsym(RTLD_DEFAULT, name));
+        };
+        get_sym("SDL_JoystickOpen", JoystickOpen);
+        get_sym("SDL_JoystickClose", JoystickClose);
+        get_sym("SDL_JoystickNumButtons", JoystickNumButtons);
+        get_sym("SDL_JoystickGetButton", JoystickGetButton);
+        get_sym("SDL_JoystickUpdate", JoystickUpdate);
+
+        joystick = JoystickOpen(index);
+        buttons = JoystickNumButtons(joystick);
+    }
+
+    ~LegacySDLController() {
+        JoystickClose(joystick);
+    }
+
+    std::string BindAction(Controller::Action action) {
+        JoystickUpdate();
+        for (int i = 0; i < buttons; ++i) {
+            if (JoystickGetButton(joystick, i)) {
+                bindings[action] = i;
+                return "Button " + std::to_string(i);
+            }
+        }
+        return "";
+    }
+
+    Controller::Action GetState() {
+        JoystickUpdate();
+        Controller::Action res{};
+        for (auto& pair : bindings) {
+            if (JoystickGetButton(joystick, pair.second)) {
+                res = static_cast<Controller::Action>(res | pair.first);
+            }
+        }
+        return res;
+    }
+
+    void Bind(Controller::Action action, int button) {
+        bindings[action] = button;
+    }
+
+private:
+    void* (*JoystickOpen)(int) = nullptr;
+    void (*JoystickClose)(void*) = nullptr;
+    int (*JoystickNumButtons)(void*) = nullptr;
+    unsigned char (*JoystickGetButton)(void*, int) = nullptr;
+    int (*JoystickUpdate)() = nullptr;
+
+    std::map<Controller::Action, int> bindings;
+    void* joystick = nullptr;
+    int buttons = 0;
+};
+
+static Controller* controller = nullptr;
+static LegacySDLController* legacy = nullptr;
+
+// Opens joystick 0 with every action bound, each action to its own button.
+static void open_sdl(bool use_events) {
+    FakeSDL_SetJoysticks(1, BUTTONS);
+    sdl_init(use_events);
+    controller = sdl_open(0);
+    for (size_t i = 0; i < std::size(ACTIONS); ++i) {
+        FakeSDL_SetButton(0, static_cast<int>(i), 1);
+        controller->BindAction(ACTIONS[i]);
+        FakeSDL_SetButton(0, static_cast<int>(i), 0);
+    }
+    controller->GetState();
+    Controller::Edge edge;
+    while (controller->PopEdge(edge)) {
+    }
+}
+
+static std::array<Controller*, 4> group;
+
+// Opens four joysticks, polled, each with Dash on button 0.
+static void open_sdl_group() {
+    FakeSDL_SetJoysticks(static_cast<int>(group.size()), BUTTONS);
+    sdl_init(false);
+    for (size_t i = 0; i < group.size(); ++i) {
+        group[i] = sdl_open(static_cast<int>(i));
+        group[i]->SetBinding(Controller::Action::Dash, 0);
+    }
+}
+
+static void close_sdl() {
+    sdl_exit();
+    controller = nullptr;
+    group.fill(nullptr);
+}
+
+static void open_legacy() {
+    FakeSDL_SetJoysticks(1, BUTTONS);
+    legacy = new LegacySDLController(0);
+    for (size_t i = 0; i < std::size(ACTIONS); ++i) {
+        legacy->Bind(ACTIONS[i], static_cast<int>(i));
+    }
+}
+
+static void close_legacy() {
+    delete legacy;
+    legacy = nullptr;
+}
+
+// Dash button pattern fed to the edge and render paths: a press every 16
+// iterations, held for 8.
+static Controller::Action pattern(uint64_t i) {
+    return (i & 8) ? Controller::Action::Dash : Controller::Action{};
+}
+
+static int null_fd = -1;
+static EdgeOutput edge_output;
+
+static std::vector<Benchmark> benchmarks() {
+    std::vector<Benchmark> res;
+
+    res.push_back({"sdl/GetState polled",
+        [] { open_sdl(false); },
+        [] { return static_cast<uint64_t>(controller->GetState()); },
+        close_sdl});
+    res.push_back({"sdl/GetState polled legacy",
+        open_legacy,
+        [] { return static_cast<uint64_t>(legacy->GetState()); },
+        close_legacy});
+    // Dash moved to a trigger: one axis read and the threshold pass.
+    res.push_back({"sdl/GetState polled axis",
+        [] { open_sdl(false); controller->SetBinding(Controller::Action::Dash, AxisBindings::Code(2, false, true)); },
+        [] { return static_cast<uint64_t>(controller->GetState()); },
+        close_sdl});
+    res.push_back({"sdl/GetState events idle",
+        [] { open_sdl(true); },
+        [] { return static_cast<uint64_t>(controller->GetState()); },
+        close_sdl});
+
+    // One button event per op, delivered and drained as edges.
+    res.push_back({"sdl/GetState events edge",
+        [] { open_sdl(true); },
+        [] {
+            static int pressed = 0;
+            pressed ^= 1;
+            FakeSDL_SetButton(0, 0, pressed);
+            uint64_t acc = controller->GetState();
+            Controller::Edge edge;
+            while (controller->PopEdge(edge)) {
+                acc += edge.state;
+            }
+            return acc;
+        },
+        close_sdl});
+
+    // Four joysticks per op, each polled on its own or all at once.
+    res.push_back({"sdl/GetState polled x4",
+        [] { open_sdl_group(); },
+        [] {
+            uint64_t acc = 0;
+            for (auto* member : group) {
+                acc += member->GetState();
+            }
+            return acc;
+        },
+        close_sdl});
+    res.push_back({"sdl/PollGroup polled x4",
+        [] { open_sdl_group(); },
+        [] {
+            group[0]->PollGroup()();
+            uint64_t acc = 0;
+            for (auto* member : group) {
+                acc += member->PolledState();
+            }
+            return acc;
+        },
+        close_sdl});
+
+    // The sampler thread itself on a 20 us grid for 300 ms, each op one
+    // slot: reading every joystick and detecting edges, as the median of the
+    // sampler's own poll cost. The virtual loop is what runs for mixed
+    // backends.
+    const auto slot = [](size_t count, bool specialize) {
+        return [count, specialize] {
+            FastClock::Calibrate();
+            FakeSDL_SetJoysticks(static_cast<int>(count), BUTTONS);
+            sdl_init(false);
+            std::vector<Controller*> controllers;
+            for (size_t i = 0; i < count; ++i) {
+                controllers.push_back(sdl_open(static_cast<int>(i)));
+                controllers.back()->SetBinding(Controller::Action::Dash, 0);
+            }
+
+            SchedulerOptions options;
+            options.period = std::chrono::microseconds(20);
+            options.idle_after = std::chrono::milliseconds(0);
+            double ns;
+            {
+                Sampler sampler(controllers, options, specialize);
+                std::this_thread::sleep_for(std::chrono::milliseconds(300));
+                sampler.Stop();
+                ns = static_cast<double>(sampler.PollCost().Percentile(0.5));
+            }
+            sdl_exit();
+            return ns;
+        };
+    };
+    res.push_back({"sampler/slot x1 virtual", nullptr, nullptr, nullptr, slot(1, false)});
+    res.push_back({"sampler/slot x1 specialized", nullptr, nullptr, nullptr, slot(1, true)});
+    res.push_back({"sampler/slot x4 virtual", nullptr, nullptr, nullptr, slot(4, false)});
+    res.push_back({"sampler/slot x4 specialized", nullptr, nullptr, nullptr, slot(4, true)});
+
+    // Unplug with a button held, then plug back in and press again: the time
+    // from the device coming back to timing resuming.
+    res.push_back({"sdl/hotplug reattach",
+        [] { open_sdl(true); },
+        [] {
+            FakeSDL_SetButton(0, 0, 1);
+            FakeSDL_Unplug(0);
+            uint64_t acc = controller->GetState() + controller->Attached();
+            FakeSDL_Plug(0);
+            FakeSDL_SetButton(0, 0, 1);
+            acc += controller->GetState() + controller->Attached();
+            FakeSDL_SetButton(0, 0, 0);
+            Controller::Edge edge;
+            while (controller->PopEdge(edge)) {
+                acc += edge.state;
+            }
+            return acc;
+        },
+        close_sdl});
+
+    res.push_back({"sdl/BindAction",
+        [] { open_sdl(false); FakeSDL_SetButton(0, 5, 1); },
+        [] { return static_cast<uint64_t>(controller->BindAction(Controller::Action::Pause).size()); },
+        [] { FakeSDL_SetButton(0, 5, 0); close_sdl(); }});
+    res.push_back({"sdl/BindAction legacy",
+        [] { open_legacy(); FakeSDL_SetButton(0, 5, 1); },
+        [] { return static_cast<uint64_t>(legacy->BindAction(Controller::Action::Pause).size()); },
+        [] { FakeSDL_SetButton(0, 5, 0); close_legacy(); }});
+
+    // Sampler side: compare with the previous state and publish the change,
+    // consumer side: pop it again. Four polls per op, with an edge every
+    // eighth op.
+    res.push_back({"edge/detect",
+        nullptr,
+        [] {
+            struct Edge {
+                BenchClock::time_point time;
+                Controller::Action state;
+                Controller::Action edges;
+            };
+            static SpscRing<Edge, 4096> ring;
+            static Controller::Action prev{};
+            static uint64_t i = 0;
+
+            uint64_t acc = 0;
+            for (int poll = 0; poll < 4; ++poll) {
+                const auto state = pattern(i++ / 4);
+                if (state != prev) {
+                    ring.Push({BenchClock::now(), state, static_cast<Controller::Action>(state ^ prev)});
+                    prev = state;
+                }
+            }
+            Edge edge;
+            while (ring.Pop(edge)) {
+                acc += edge.edges & edge.state;
+            }
+            return acc;
+        },
+        nullptr});
+    res.push_back({"edge/detect legacy",
+        nullptr,
+        [] {
+            static Controller::Action prev{};
+            static uint64_t i = 0;
+
+            uint64_t acc = 0;
+            for (int poll = 0; poll < 4; ++poll) {
+                const auto state = pattern(i++ / 4);
+                const auto buttons_event = state ^ prev;
+                const auto buttons_down = buttons_event & state;
+                const auto buttons_up = buttons_event & prev;
+                const auto current_time = BenchClock::now();
+                acc += buttons_down + buttons_up + static_cast<uint64_t>(current_time.time_since_epoch().count() & 1);
+                prev = state;
+            }
+            return acc;
+        },
+        nullptr});
+
+    // One timestamp per op. The TSC clock stays on steady_clock where there
+    // is no invariant TSC.
+    res.push_back({"clock/steady_clock",
+        nullptr,
+        [] { return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()); },
+        nullptr});
+    res.push_back({"clock/FastClock",
+        [] { FastClock::Calibrate(); },
+        [] { return static_cast<uint64_t>(FastClock::now().time_since_epoch().count()); },
+        nullptr});
+
+    // One graded edge per op into the running statistics, a 5 ms step of
+    // time each.
+    res.push_back({"stats/add",
+        nullptr,
+        [] {
+            static LiveStats stats;
+            static uint64_t i = 0;
+            const auto interval = std::chrono::nanoseconds(83412000 + i % 1000);
+            stats.Add(Controller::Clock::time_point(std::chrono::milliseconds(5 * i)), (i & 1) != 0, interval,
+                GradeDash((i & 1) == 0, interval));
+            ++i;
+            return static_cast<uint64_t>(stats.BestStreak());
+        },
+        nullptr});
+
+    // One press per op against 64 three-step patterns over Dash, Slash and
+    // Item, the presses cycling through the same buttons.
+    static SequenceRecognizer sequences;
+    res.push_back({"sequence/press 64 patterns",
+        [] {
+            std::vector<SequencePattern> patterns;
+            const Controller::Action buttons[] = {Controller::Action::Dash, Controller::Action::Slash, Controller::Action::Item};
+            for (int i = 0; i < 64; ++i) {
+                SequencePattern pattern{"p", {buttons[i % 3], buttons[i / 3 % 3], buttons[i / 9 % 3]}, {"a", "b", "c"},
+                    std::vector<GradeTable>(3, GradeTable(DASH_UP_STEPS, std::size(DASH_UP_STEPS), 60)), std::chrono::seconds(1)};
+                patterns.push_back(pattern);
+            }
+            sequences.Compile(std::move(patterns));
+        },
+        [] {
+            static SequenceCursor cursor;
+            static uint64_t i = 0;
+            static const Controller::Action presses[] = {Controller::Action::Dash, Controller::Action::Slash,
+                Controller::Action::Dash, Controller::Action::Item, Controller::Action::Slash};
+            const auto pressed = presses[i % std::size(presses)];
+            uint64_t acc = 0;
+            sequences.Press(cursor, pressed, pressed, Controller::Clock::time_point(std::chrono::milliseconds(50 * i)),
+                [&](size_t index, const Controller::Clock::time_point*) { acc += index; });
+            ++i;
+            return acc + cursor.state;
+        },
+        nullptr});
+
+    // Intervals sweeping across the dash thresholds, alternately down and up.
+    res.push_back({"grade/dash",
+        nullptr,
+        [] {
+            static uint64_t i = 0;
+            ++i;
+            const auto delta_time = std::chrono::microseconds(i * 977 % 40000);
+            return static_cast<uint64_t>(GradeDash((i & 1) != 0, delta_time));
+        },
+        nullptr});
+    res.push_back({"grade/dash runtime table",
+        nullptr,
+        [] {
+            static const auto tables = MakeDashTables(sink != 0 ? 60 : 61);
+            static uint64_t i = 0;
+            ++i;
+            const auto delta_time = std::chrono::microseconds(i * 977 % 40000);
+            return static_cast<uint64_t>(tables.Evaluate((i & 1) != 0, delta_time));
+        },
+        nullptr});
+    res.push_back({"grade/dash legacy",
+        nullptr,
+        [] {
+            static constexpr auto frame_duration =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::seconds(1)) / 60;
+            static uint64_t i = 0;
+            ++i;
+            const auto delta_time = std::chrono::microseconds(i * 977 % 40000);
+            Grade grade;
+            if ((i & 1) != 0) {
+                grade = (delta_time < frame_duration * 32) ? Grade::Green : Grade::Red;
+            } else if (delta_time >= frame_duration * 1.3f || delta_time < frame_duration * 0.2f) {
+                grade = Grade::Red;
+            } else if (delta_time < frame_duration * 0.5f || delta_time > frame_duration) {
+                grade = Grade::Yellow;
+            } else {
+                grade = Grade::Green;
+            }
+            return static_cast<uint64_t>(grade);
+        },
+        nullptr});
+
+    // One status line per op with a new millisecond count, so every op
+    // renders and writes; a commit every 8 ops.
+    res.push_back({"render/status",
+        [] { null_fd = open("/dev/null", O_WRONLY); },
+        [] {
+            static StatusRenderer renderer(null_fd);
+            static uint64_t i = 0;
+            static unsigned int event_id = 0;
+
+            const auto state = pattern(i);
+            const bool commit = pattern(i + 1) != state;
+            const bool isdown = state != 0;
+            const auto delta_time = std::chrono::milliseconds(i % 8 + 1);
+            const char* color = GRADE_COLORS[static_cast<int>(GradeDash(isdown, delta_time))];
+            renderer.Status(0, color, "dash", event_id, isdown, delta_time.count(), commit);
+            renderer.Flush();
+            if (commit) {
+                event_id = (event_id + 1) % 1000;
+            }
+            ++i;
+            return static_cast<uint64_t>(event_id);
+        },
+        [] { close(null_fd); }});
+    res.push_back({"render/status legacy",
+        [] { null_fd = open("/dev/null", O_WRONLY); },
+        [] {
+            static std::string output;
+            static uint64_t i = 0;
+            static unsigned int event_id = 0;
+
+            const auto state = pattern(i);
+            const bool commit = pattern(i + 1) != state;
+            const bool isdown = state != 0;
+            const auto delta_time = std::chrono::milliseconds(i % 8 + 1);
+
+            output.clear();
+            output += GRADE_COLORS[static_cast<int>(GradeDash(isdown, delta_time))];
+
+            char event_id_buf[10];
+            snprintf(event_id_buf, sizeof(event_id_buf), "%03u", event_id);
+
+            output += "\r";
+            output += std::string(event_id_buf) + " dash button " + (isdown ? "down" : "up");
+            output += " (" + std::to_string(delta_time.count()) + " ms)";
+
+            output = output.substr(0, 64);
+            output.resize(64, ' ');
+
+            if (commit) {
+                output += "\n";
+                event_id = (event_id + 1) % 1000;
+            }
+            StatusRenderer::Write(null_fd, output.data(), output.size());
+            ++i;
+            return static_cast<uint64_t>(event_id);
+        },
+        [] { close(null_fd); }});
+
+    // One graded edge per op, formatted as a JSON line into /dev/null.
+    res.push_back({"output/jsonl",
+        [] { edge_output.Open("/dev/null", OutputFormat::JsonLines, Controller::Clock::now()); },
+        [] {
+            static uint64_t i = 0;
+            const auto interval = std::chrono::nanoseconds(83412000 + i % 1000);
+            edge_output.Append({Controller::Clock::now(), 0, static_cast<unsigned int>(i % 1000), "Dash", (i & 1) != 0, interval,
+                GradeDash((i & 1) == 0, interval)});
+            return ++i;
+        },
+        [] { edge_output.Close(); }});
+    res.push_back({"output/jsonl legacy",
+        [] { null_fd = open("/dev/null", O_WRONLY); },
+        [] {
+            static uint64_t i = 0;
+            const auto interval = std::chrono::nanoseconds(83412000 + i % 1000);
+            static const char* const grades[] = {"red", "yellow", "green"};
+            std::ostringstream line;
+            line << "{\"time_ns\":" << BenchClock::now().time_since_epoch().count() << ",\"device\":0,\"event\":" << i % 1000
+                << ",\"action\":\"Dash\",\"edge\":\"" << ((i & 1) != 0 ? "press" : "release")
+                << "\",\"interval_ns\":" << interval.count()
+                << ",\"grade\":\"" << grades[static_cast<int>(GradeDash((i & 1) == 0, interval))] << "\"}\n";
+            const auto text = line.str();
+            StatusRenderer::Write(null_fd, text.data(), text.size());
+            return ++i;
+        },
+        [] { close(null_fd); }});
+
+    return res;
+}
+
+int main(int argc, char** argv) {
+#ifndef NDEBUG
+    std::fprintf(stderr, "warning: unoptimized build, configure with -DCMAKE_BUILD_TYPE=Release\n");
+#endif
+
+    // Arguments filter benchmarks by substring.
+    for (const auto& benchmark : benchmarks()) {
+        if (argc > 1 && std::none_of(argv + 1, argv + argc, [&](const char* filter) {
+                return std::strstr(benchmark.name, filter) != nullptr; })) {
+            continue;
+        }
+
+        if (benchmark.setup) {
+            benchmark.setup();
+        }
+        const auto ns = benchmark.run ? measure(benchmark.run) : benchmark.self_timed();
+        if (benchmark.teardown) {
+            benchmark.teardown();
+        }
+
+        std::printf("%-32s %10.1f ns/op\n", benchmark.name, ns);
+        std::fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "fake_sdl.h"
+
+#define FAKE_SDL_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace {
+
+constexpr uint32_t SDL_JOYAXISMOTION = 0x600;
+constexpr uint32_t SDL_JOYHATMOTION = 0x602;
+constexpr uint32_t SDL_JOYBUTTONDOWN = 0x603;
+constexpr uint32_t SDL_JOYBUTTONUP = 0x604;
+constexpr uint32_t SDL_JOYDEVICEADDED = 0x605;
+constexpr uint32_t SDL_JOYDEVICEREMOVED = 0x606;
+
+struct JoyButtonEvent {
+    uint32_t type;
+    uint32_t timestamp;
+    int32_t which;
+    uint8_t button;
+    uint8_t state;
+    uint8_t padding1;
+    uint8_t padding2;
+};
+
+// Large enough for any joystick event the fake queues.
+struct JoyAxisEvent {
+    uint32_t type;
+    uint32_t timestamp;
+    int32_t which;
+    uint8_t axis;
+    uint8_t padding1;
+    uint8_t padding2;
+    uint8_t padding3;
+    int16_t value;
+    uint16_t padding4;
+};
+
+struct Joystick {
+    std::vector<uint8_t> buttons;
+    std::vector<int16_t> axes = std::vector<int16_t>(4);
+    std::vector<uint8_t> hats = std::vector<uint8_t>(1);
+    bool open = false;
+    bool plugged = true;
+    uint64_t updates = 0;
+};
+
+std::vector<Joystick> joysticks(1, Joystick{std::vector<uint8_t>(16)});
+union Event {
+    JoyButtonEvent button;
+    JoyAxisEvent axis;
+};
+
+std::deque<Event> events;
+std::mutex joystick_lock;
+const auto start = std::chrono::steady_clock::now();
+
+uint32_t ticks() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+Joystick* get(void* joystick) {
+    return static_cast<Joystick*>(joystick);
+}
+
+}
+
+FAKE_SDL_EXPORT void FakeSDL_SetJoysticks(int count, int buttons) {
+    joysticks.assign(static_cast<size_t>(count), Joystick{std::vector<uint8_t>(static_cast<size_t>(buttons))});
+    events.clear();
+}
+
+FAKE_SDL_EXPORT void FakeSDL_SetButton(int index, int button, int pressed) {
+    auto& joystick = joysticks[static_cast<size_t>(index)];
+    joystick.buttons[static_cast<size_t>(button)] = pressed != 0;
+    if (joystick.open) {
+        events.push_back({{pressed ? SDL_JOYBUTTONDOWN : SDL_JOYBUTTONUP, ticks(), index,
+            static_cast<uint8_t>(button), static_cast<uint8_t>(pressed != 0), 0, 0}});
+    }
+}
+
+FAKE_SDL_EXPORT void FakeSDL_SetAxis(int index, int axis, int value) {
+    auto& joystick = joysticks[static_cast<size_t>(index)];
+    joystick.axes[static_cast<size_t>(axis)] = static_cast<int16_t>(value);
+    if (joystick.open) {
+        Event event{};
+        event.axis = {SDL_JOYAXISMOTION, ticks(), index, static_cast<uint8_t>(axis), 0, 0, 0, static_cast<int16_t>(value), 0};
+        events.push_back(event);
+    }
+}
+
+FAKE_SDL_EXPORT void FakeSDL_SetHat(int index, int hat, int value) {
+    auto& joystick = joysticks[static_cast<size_t>(index)];
+    joystick.hats[static_cast<size_t>(hat)] = static_cast<uint8_t>(value);
+    if (joystick.open) {
+        events.push_back({{SDL_JOYHATMOTION, ticks(), index, static_cast<uint8_t>(hat), static_cast<uint8_t>(value), 0, 0}});
+    }
+}
+
+FAKE_SDL_EXPORT void FakeSDL_Unplug(int index) {
+    auto& joystick = joysticks[static_cast<size_t>(index)];
+    joystick.plugged = false;
+    joystick.open = false;
+    std::fill(joystick.buttons.begin(), joystick.buttons.end(), 0);
+    events.push_back({{SDL_JOYDEVICEREMOVED, ticks(), index, 0, 0, 0, 0}});
+}
+
+FAKE_SDL_EXPORT void FakeSDL_Plug(int index) {
+    joysticks[static_cast<size_t>(index)].plugged = true;
+    events.push_back({{SDL_JOYDEVICEADDED, ticks(), index, 0, 0, 0, 0}});
+}
+
+FAKE_SDL_EXPORT int SDL_Init(unsigned int) {
+    return 0;
+}
+
+FAKE_SDL_EXPORT int SDL_Quit() {
+    events.clear();
+    return 0;
+}
+
+FAKE_SDL_EXPORT int SDL_NumJoysticks() {
+    return static_cast<int>(joysticks.size());
+}
+
+FAKE_SDL_EXPORT void* SDL_JoystickOpen(int index) {
+    auto& joystick = joysticks[static_cast<size_t>(index)];
+    if (!joystick.plugged) {
+        return nullptr;
+    }
+    joystick.open = true;
+    return &joystick;
+}
+
+FAKE_SDL_EXPORT void SDL_JoystickClose(void* joystick) {
+    get(joystick)->open = false;
+}
+
+FAKE_SDL_EXPORT const char* SDL_JoystickNameForIndex(int) {
+    return "Fake joystick";
+}
+
+FAKE_SDL_EXPORT int SDL_JoystickNumButtons(void* joystick) {
+    return static_cast<int>(get(joystick)->buttons.size());
+}
+
+FAKE_SDL_EXPORT unsigned char SDL_JoystickGetButton(void* joystick, int button) {
+    return get(joystick)->buttons[static_cast<size_t>(button)];
+}
+
+FAKE_SDL_EXPORT int SDL_JoystickNumAxes(void* joystick) {
+    return static_cast<int>(get(joystick)->axes.size());
+}
+
+FAKE_SDL_EXPORT int16_t SDL_JoystickGetAxis(void* joystick, int axis) {
+    return get(joystick)->axes[static_cast<size_t>(axis)];
+}
+
+FAKE_SDL_EXPORT int SDL_JoystickNumHats(void* joystick) {
+    return static_cast<int>(get(joystick)->hats.size());
+}
+
+FAKE_SDL_EXPORT uint8_t SDL_JoystickGetHat(void* joystick, int hat) {
+    return get(joystick)->hats[static_cast<size_t>(hat)];
+}
+
+// Like SDL, a global update takes the joystick lock and visits every open
+// joystick, whichever one the caller is interested in.
+FAKE_SDL_EXPORT int SDL_JoystickUpdate() {
+    std::lock_guard<std::mutex> lock(joystick_lock);
+    for (auto& joystick : joysticks) {
+        if (joystick.open) {
+            ++joystick.updates;
+        }
+    }
+    return 0;
+}
+
+FAKE_SDL_EXPORT void SDL_PumpEvents() {
+    SDL_JoystickUpdate();
+}
+
+struct JoystickGUID {
+    uint8_t data[16];
+};
+
+FAKE_SDL_EXPORT JoystickGUID SDL_JoystickGetDeviceGUID(int index) {
+    JoystickGUID guid{{0x03, 0x00, 0x00, 0x00, 0xfa, 0x4e}};
+    guid.data[15] = static_cast<uint8_t>(index);
+    return guid;
+}
+
+FAKE_SDL_EXPORT int32_t SDL_JoystickInstanceID(void* joystick) {
+    return static_cast<int32_t>(get(joystick) - joysticks.data());
+}
+
+FAKE_SDL_EXPORT uint32_t SDL_GetTicks() {
+    return ticks();
+}
+
+FAKE_SDL_EXPORT int SDL_PollEvent(void* event) {
+    if (events.empty()) {
+        return 0;
+    }
+    if (event != nullptr) {
+        std::memcpy(event, &events.front(), sizeof(Event));
+        events.pop_front();
+    }
+    return 1;
+}
+
+FAKE_SDL_EXPORT int SDL_WaitEventTimeout(void* event, int) {
+    return SDL_PollEvent(event);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Scripting interface of the fake libSDL2 used by the benchmarks. Every
+// joystick starts with all buttons released, four centered axes and one
+// centered hat.
+extern "C" {
+void FakeSDL_SetJoysticks(int count, int buttons);
+void FakeSDL_SetButton(int index, int button, int pressed);
+void FakeSDL_SetAxis(int index, int axis, int value);
+void FakeSDL_SetHat(int index, int hat, int value);
+// Queue device removed and added events; an unplugged joystick is closed
+// and cannot be opened until it is plugged back in.
+void FakeSDL_Unplug(int index);
+void FakeSDL_Plug(int index);
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "controller.h"
+
+// Button index bindings compiled into a dense per-button action mask table
+// and a compact list of the bound buttons. A button may carry several
+// actions and an action may be bound to several buttons.
+class ButtonBindings {
+public:
+    void Set(Controller::Action action, int button) {
+        Clear(action);
+        Add(action, button);
+    }
+
+    void Add(Controller::Action action, int button) {
+        if (button < 0) {
+            return;
+        }
+        if (masks.size() <= static_cast<size_t>(button)) {
+            masks.resize(static_cast<size_t>(button) + 1);
+        }
+        masks[button] |= action;
+        Compile();
+    }
+
+    void Clear(Controller::Action action) {
+        for (auto& mask : masks) {
+            mask &= ~action;
+        }
+        Compile();
+    }
+
+    // Lowest button bound to the action, -1 if none.
+    int Find(Controller::Action action) const {
+        for (const auto& entry : entries) {
+            if (entry.mask & action) {
+                return entry.button;
+            }
+        }
+        return -1;
+    }
+
+    // One query per distinct bound button, for sources read through calls.
+    template <typename Pressed>
+    Controller::Action Evaluate(Pressed&& pressed) const {
+        unsigned int res = 0;
+        for (const auto& entry : entries) {
+            res |= entry.mask & (0u - static_cast<unsigned int>(pressed(entry.button) != 0));
+        }
+        return static_cast<Controller::Action>(res);
+    }
+
+    // Single pass over a contiguous button array, for sources read as a block.
+    Controller::Action Evaluate(const unsigned char* buttons, size_t count) const {
+        const auto size = count < masks.size() ? count : masks.size();
+        unsigned int res = 0;
+        for (size_t i = 0; i < size; ++i) {
+            res |= masks[i] & (0u - static_cast<unsigned int>(buttons[i] != 0));
+        }
+        return static_cast<Controller::Action>(res);
+    }
+
+private:
+    struct Entry {
+        int button;
+        unsigned int mask;
+    };
+
+    void Compile() {
+        while (!masks.empty() && masks.back() == 0) {
+            masks.pop_back();
+        }
+        entries.clear();
+        for (size_t i = 0; i < masks.size(); ++i) {
+            if (masks[i] != 0) {
+                entries.push_back({static_cast<int>(i), masks[i]});
+            }
+        }
+    }
+
+    std::vector<uint8_t> masks;
+    std::vector<Entry> entries;
+};
+
+// Bindings on a 16-bit button word, translated to actions through two
+// byte-indexed lookup tables.
+class MaskBindings {
+public:
+    void Set(Controller::Action action, uint16_t buttons) {
+        Clear(action);
+        Add(action, buttons);
+    }
+
+    void Add(Controller::Action action, uint16_t buttons) {
+        for (size_t bit = 0; bit < bits.size(); ++bit) {
+            if (buttons & (1u << bit)) {
+                bits[bit] |= action;
+            }
+        }
+        Compile();
+    }
+
+    void Clear(Controller::Action action) {
+        for (auto& mask : bits) {
+            mask &= ~action;
+        }
+        Compile();
+    }
+
+    // Button word bound to the action, 0 if none.
+    uint16_t Find(Controller::Action action) const {
+        uint16_t res = 0;
+        for (size_t bit = 0; bit < bits.size(); ++bit) {
+            if (bits[bit] & action) {
+                res |= static_cast<uint16_t>(1u << bit);
+            }
+        }
+        return res;
+    }
+
+    Controller::Action Evaluate(uint16_t buttons) const {
+        return static_cast<Controller::Action>(low[buttons & 0xff] | high[buttons >> 8]);
+    }
+
+private:
+    void Compile() {
+        for (size_t value = 0; value < low.size(); ++value) {
+            low[value] = 0;
+            high[value] = 0;
+            for (size_t bit = 0; bit < 8; ++bit) {
+                if (value & (1u << bit)) {
+                    low[value] |= bits[bit];
+                    high[value] |= bits[bit + 8];
+                }
+            }
+        }
+    }
+
+    std::array<uint8_t, 16> bits{};
+    std::array<uint8_t, 256> low{};
+    std::array<uint8_t, 256> high{};
+};
+
+// Analog axes bound like buttons, with hysteresis. Axes are read as int16;
+// triggers rest at -32768, sticks and hats at 0, which a binding remembers
+// together with the direction it was pushed in. Bindings live in small
+// fixed arrays evaluated in a single branch-free pass, unused slots can
+// never fire.
+//
+// Binding codes are above any button code so that both kinds share the
+// GetBinding()/SetBinding() code space.
+class AxisBindings {
+public:
+    static constexpr size_t MAX_ENTRIES = 8;
+    static constexpr int CODE_BASE = 0x10000;
+
+    static int Code(int axis, bool negative, bool trigger) {
+        return CODE_BASE | axis << 2 | (trigger ? 2 : 0) | (negative ? 1 : 0);
+    }
+
+    static bool IsCode(int code) {
+        return code >= CODE_BASE;
+    }
+
+    static int Axis(int code) {
+        return (code & ~CODE_BASE) >> 2;
+    }
+
+    static std::string Name(int code) {
+        return "Axis " + std::to_string(Axis(code)) + ((code & 1) ? "-" : "+");
+    }
+
+    // Code of the first axis pushed past the press threshold away from its
+    // rest position, -1 when none is.
+    static int Detect(const int16_t* axes, const int16_t* rest, size_t count, const Controller::AxisThreshold& threshold) {
+        for (size_t i = 0; i < count; ++i) {
+            const bool trigger = rest[i] < -16384;
+            for (const bool negative : {false, true}) {
+                if (!(trigger && negative) && Travel(axes[i], negative, trigger) >= Limit(threshold.press, negative, trigger)) {
+                    return Code(static_cast<int>(i), negative, trigger);
+                }
+            }
+        }
+        return -1;
+    }
+
+    void SetThreshold(const Controller::AxisThreshold& new_threshold) {
+        threshold = new_threshold;
+        Compile();
+    }
+
+    void Set(Controller::Action action, int code) {
+        Clear(action);
+        Add(action, code);
+    }
+
+    bool Add(Controller::Action action, int code) {
+        if (!IsCode(code)) {
+            return false;
+        }
+        for (auto& binding : bindings) {
+            if (binding.code == code) {
+                binding.mask |= action;
+                Compile();
+                return true;
+            }
+        }
+        if (bindings.size() == MAX_ENTRIES) {
+            return false;
+        }
+        bindings.push_back({code, static_cast<unsigned int>(action)});
+        Compile();
+        return true;
+    }
+
+    void Clear(Controller::Action action) {
+        for (auto& binding : bindings) {
+            binding.mask &= ~action;
+        }
+        bindings.erase(std::remove_if(bindings.begin(), bindings.end(), [](const Binding& binding) {
+            return binding.mask == 0;
+        }), bindings.end());
+        Compile();
+    }
+
+    // Code bound to the action, -1 if none.
+    int Find(Controller::Action action) const {
+        for (const auto& binding : bindings) {
+            if (binding.mask & action) {
+                return binding.code;
+            }
+        }
+        return -1;
+    }
+
+    bool Empty() const {
+        return bindings.empty();
+    }
+
+    // One query per bound axis, for sources read through calls.
+    template <typename Value>
+    Controller::Action Evaluate(Value&& value) {
+        std::array<int32_t, MAX_ENTRIES> values{};
+        for (size_t i = 0; i < bindings.size(); ++i) {
+            values[i] = value(axis[i]);
+        }
+        return Pass(values);
+    }
+
+    // Gathers the bound axes out of a block holding all of them.
+    Controller::Action Evaluate(const int16_t* axes, size_t count) {
+        std::array<int32_t, MAX_ENTRIES> values{};
+        for (size_t i = 0; i < bindings.size(); ++i) {
+            values[i] = static_cast<size_t>(axis[i]) < count ? axes[axis[i]] : 0;
+        }
+        return Pass(values);
+    }
+
+private:
+    struct Binding {
+        int code;
+        unsigned int mask;
+    };
+
+    // Distance travelled from rest in the bound direction, up to 65535 for
+    // triggers and 32767 (or 32768) for the halves of a stick.
+    static int32_t Travel(int32_t value, bool negative, bool trigger) {
+        return trigger ? value + 32768 : negative ? -value : value;
+    }
+
+    static int32_t Limit(int fraction, bool negative, bool trigger) {
+        const int32_t range = trigger ? 65535 : negative ? 32768 : 32767;
+        return static_cast<int32_t>(static_cast<int64_t>(range) * fraction / 32767);
+    }
+
+    // Fixed trip count over plain arrays, so the compiler can keep the whole
+    // pass in vector registers.
+    Controller::Action Pass(const std::array<int32_t, MAX_ENTRIES>& values) {
+        unsigned int res = 0;
+        for (size_t i = 0; i < MAX_ENTRIES; ++i) {
+            const int32_t travel = values[i] * scale[i] + offset[i];
+            held[i] = travel >= (held[i] ? release[i] : press[i]);
+            res |= mask[i] & (0u - static_cast<unsigned int>(held[i]));
+        }
+        return static_cast<Controller::Action>(res);
+    }
+
+    // Travel is value * scale + offset: scale is -1 for negative directions,
+    // the offset moves a trigger's rest to 0.
+    void Compile() {
+        for (size_t i = 0; i < MAX_ENTRIES; ++i) {
+            axis[i] = 0;
+            scale[i] = 0;
+            offset[i] = 0;
+            press[i] = INT32_MAX;
+            release[i] = INT32_MAX;
+            mask[i] = 0;
+            held[i] = 0;
+        }
+        for (size_t i = 0; i < bindings.size(); ++i) {
+            const int code = bindings[i].code;
+            const bool negative = (code & 1) != 0;
+            const bool trigger = (code & 2) != 0;
+            axis[i] = Axis(code);
+            scale[i] = negative ? -1 : 1;
+            offset[i] = trigger ? 32768 : 0;
+            press[i] = Limit(threshold.press, negative, trigger);
+            release[i] = Limit(threshold.release < threshold.press ? threshold.release : threshold.press, negative, trigger);
+            mask[i] = bindings[i].mask;
+        }
+    }
+
+    Controller::AxisThreshold threshold;
+    std::vector<Binding> bindings;
+
+    std::array<int, MAX_ENTRIES> axis{};
+    std::array<int32_t, MAX_ENTRIES> scale{};
+    std::array<int32_t, MAX_ENTRIES> offset{};
+    std::array<int32_t, MAX_ENTRIES> press{};
+    std::array<int32_t, MAX_ENTRIES> release{};
+    std::array<unsigned int, MAX_ENTRIES> mask{};
+    std::array<int32_t, MAX_ENTRIES> held{};
+};
@@ -0,0 +1,106 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "binding_cache.h"
+#include "replay.h"
+
+std::string BindingCache::DefaultPath() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (base == nullptr || *base == '\0') {
+        return "";
+    }
+    return (std::filesystem::path(base) / "hoverpractice" / "bindings.txt").string();
+#else
+    const char* base = std::getenv("XDG_CACHE_HOME");
+    if (base != nullptr && *base != '\0') {
+        return (std::filesystem::path(base) / "hoverpractice" / "bindings.txt").string();
+    }
+    const char* home = std::getenv("HOME");
+    if (home == nullptr || *home == '\0') {
+        return "";
+    }
+    return (std::filesystem::path(home) / ".cache" / "hoverpractice" / "bindings.txt").string();
+#endif
+}
+
+bool BindingCache::Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    // Lines that do not parse are dropped, the file is rewritten on save.
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream stream(line);
+        std::string key;
+        if (!(stream >> key) || key[0] == '#') {
+            continue;
+        }
+
+        if (key == "last") {
+            stream >> last;
+            continue;
+        }
+
+        std::string action_text;
+        Controller::Action action;
+        int code;
+        if (stream >> action_text >> code && parse_actions(action_text, action) && action_name(action) != nullptr) {
+            Store(key, action, code);
+        }
+    }
+    return true;
+}
+
+bool BindingCache::Save(const std::string& path) const {
+    std::error_code error;
+    const auto target = std::filesystem::path(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    // Written aside and renamed over, so a crash never leaves half a file.
+    const auto temp = target.string() + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        if (!last.empty()) {
+            file << "last " << last << "\n";
+        }
+        for (const auto& entry : entries) {
+            file << entry.key << " " << action_name(entry.action) << " " << entry.code << "\n";
+        }
+        if (!file.flush()) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, target, error);
+    return !error;
+}
+
+bool BindingCache::Lookup(const std::string& key, Controller::Action action, int& code) const {
+    for (const auto& entry : entries) {
+        if (entry.key == key && entry.action == action) {
+            code = entry.code;
+            return true;
+        }
+    }
+    return false;
+}
+
+void BindingCache::Store(const std::string& key, Controller::Action action, int code) {
+    for (auto& entry : entries) {
+        if (entry.key == key && entry.action == action) {
+            entry.code = code;
+            return;
+        }
+    }
+    entries.push_back({key, action, code});
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "controller.h"
+
+// Bindings per device and the last used device, kept between runs in a
+// small text file of one entry per line:
+//   last sdl:03000000fa4e00000000000000000000
+//   sdl:03000000fa4e00000000000000000000 Dash 0
+//   sdl:03000000fa4e00000000000000000000 Map 6
+// Device keys are backend-prefixed and contain no spaces. Identical SDL
+// pads get a "#n" suffix after the first.
+class BindingCache {
+public:
+    // Per-user cache location, empty when there is none.
+    static std::string DefaultPath();
+
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    const std::string& Last() const {
+        return last;
+    }
+
+    void SetLast(const std::string& key) {
+        last = key;
+    }
+
+    bool Lookup(const std::string& key, Controller::Action action, int& code) const;
+    void Store(const std::string& key, Controller::Action action, int code);
+
+private:
+    struct Entry {
+        std::string key;
+        Controller::Action action;
+        int code;
+    };
+
+    std::string last;
+    std::vector<Entry> entries;
+};
@@ -1,21 +1,99 @@
 #pragma once
 
+#include <chrono>
 #include <string>
+#include <thread>
+
+#include "fast_clock.h"
+
+class Sampler;
 
 class Controller {
 public:
     Controller() = default;
     virtual ~Controller() = default;
 
+    using Clock = FastClock;
+
     enum Action {
         Dash =  1 << 0,
         Slash = 1 << 1,
-        Item =  1 << 2, 
+        Item =  1 << 2,
         Map =   1 << 3,
         Menu =  1 << 4,
         Pause = 1 << 5
     };
 
+    struct Edge {
+        Clock::time_point time;
+        Action state;
+    };
+
     virtual std::string BindAction(Action action) = 0;
     virtual Action GetState() = 0;
+
+    // Backends that refresh all of their open devices in one go group them
+    // under a poll function. Calling it once brings every controller of the
+    // group up to date, PolledState() then reads one back without touching
+    // the device. For a single controller this is just GetState().
+    using PollFunction = void (*)();
+
+    virtual PollFunction PollGroup() const {
+        return nullptr;
+    }
+
+    virtual Action PolledState() const {
+        return {};
+    }
+
+    // The sampling loop instantiated for the backend's own type, so that
+    // the calls above inline into it. Sampler picks it once when all of its
+    // controllers agree; nullptr leaves them to the generic loop.
+    using SampleLoop = void (*)(Sampler& sampler);
+
+    virtual SampleLoop Loop() const {
+        return nullptr;
+    }
+
+    // Backend button code bound to an action, -1 when unbound, so bindings
+    // can be restored on the next run. Codes only make sense to the backend
+    // that returned them.
+    virtual int GetBinding(Action action) const {
+        return -1;
+    }
+
+    virtual bool SetBinding(Action action, int code) {
+        return false;
+    }
+
+    // Analog axes, triggers and hats count as pressed once they travel
+    // `press` from rest and as released below `release`, both out of 32767.
+    struct AxisThreshold {
+        int press = 16384;
+        int release = 12288;
+    };
+
+    virtual void SetAxisThreshold(const AxisThreshold& threshold) {}
+
+    // Event-driven backends queue every edge with its event time;
+    // polled backends have none and are sampled through GetState().
+    virtual bool PopEdge(Edge& edge) {
+        return false;
+    }
+
+    virtual void WaitInput(std::chrono::microseconds timeout) {
+        std::this_thread::sleep_for(timeout);
+    }
+
+    // True when WaitInput() returns as soon as input arrives instead of
+    // sleeping out the timeout.
+    virtual bool WaitsForInput() const {
+        return false;
+    }
+
+    // False while the device is unplugged; it reads as released until it
+    // is back. Safe to call from any thread.
+    virtual bool Attached() const {
+        return true;
+    }
 };
@@ -5,12 +5,14 @@
 #pragma comment(lib, "dxguid.lib")
 
 #include <algorithm>
+#include <iterator>
 #include <list>
-#include <map>
 #include <memory>
 #include <string>
 
+#include "binding.h"
 #include "dinput.h"
+#include "sampler.h"
 
 LPDIRECTINPUT8 pDInput = nullptr;
 
@@ -74,14 +76,61 @@ void dinput_enum(const dinput_enum_cb& callback) {
     enum_devices(DI8DEVCLASS_KEYBOARD);
 }
 
+// The eight axes of DIJOYSTATE2 followed by every POV hat read as two
+// axes, X then Y.
+static constexpr size_t DINPUT_AXES = 8 + 2 * sizeof(DIJOYSTATE2::rgdwPOV) / sizeof(DWORD);
+
+static int16_t dinput_axis(LONG value) {
+    return static_cast<int16_t>(std::clamp<LONG>(value, -32768, 32767));
+}
+
+static void dinput_axes(const DIJOYSTATE2& state, int16_t* axes) {
+    axes[0] = dinput_axis(state.lX);
+    axes[1] = dinput_axis(state.lY);
+    axes[2] = dinput_axis(state.lZ);
+    axes[3] = dinput_axis(state.lRx);
+    axes[4] = dinput_axis(state.lRy);
+    axes[5] = dinput_axis(state.lRz);
+    axes[6] = dinput_axis(state.rglSlider[0]);
+    axes[7] = dinput_axis(state.rglSlider[1]);
+    for (size_t i = 0; i < std::size(state.rgdwPOV); ++i) {
+        // Hundredths of a degree clockwise from up, 0xFFFF when centered.
+        const DWORD angle = state.rgdwPOV[i];
+        const bool centered = LOWORD(angle) == 0xFFFF;
+        axes[8 + 2 * i] = centered ? 0 : (angle > 0 && angle < 18000) ? 32767 : (angle > 18000) ? -32768 : 0;
+        axes[9 + 2 * i] = centered ? 0 : (angle > 9000 && angle < 27000) ? 32767 : (angle < 9000 || angle > 27000) ? -32768 : 0;
+    }
+}
+
 class DInputController final : public Controller {
 public:
     DInputController(const GUID& guid) : Controller() {
         if (pDInput->CreateDevice(guid, &device, NULL) != DI_OK ||
-            device->SetDataFormat(&c_dfDIJoystick2) != DI_OK ||
-            device->Acquire() != DI_OK) {
+            device->SetDataFormat(&c_dfDIJoystick2) != DI_OK) {
+            device = nullptr;
+            return;
+        }
+
+        // Devices pick their own axis ranges, ask for the int16 one.
+        DIPROPRANGE range{};
+        range.diph.dwSize = sizeof(range);
+        range.diph.dwHeaderSize = sizeof(range.diph);
+        range.diph.dwHow = DIPH_DEVICE;
+        range.lMin = -32768;
+        range.lMax = 32767;
+        device->SetProperty(DIPROP_RANGE, &range.diph);
+
+        if (device->Acquire() != DI_OK) {
+            device->Release();
             device = nullptr;
+            return;
         }
+
+        // Whatever the axes read when opened is taken as their rest.
+        DIJOYSTATE2 dstate{};
+        device->Poll();
+        device->GetDeviceState(sizeof(dstate), reinterpret_cast<LPVOID>(&dstate));
+        dinput_axes(dstate, rest);
     }
 
     ~DInputController() {
@@ -101,36 +150,99 @@ public:
         if (device->GetDeviceState(sizeof(state), reinterpret_cast<LPVOID>(&state)) == DI_OK) {
             for (size_t i = 0; i < std::size(state.rgbButtons); ++i) {
                 if (state.rgbButtons[i]) {
-                    bindings[action] = i;
+                    bindings.Set(action, static_cast<int>(i));
+                    axis_bindings.Clear(action);
                     return "Button " + std::to_string(i + 1);
                 }
             }
+
+            int16_t axes[DINPUT_AXES];
+            dinput_axes(state, axes);
+            const int code = AxisBindings::Detect(axes, rest, DINPUT_AXES, threshold);
+            if (code >= 0) {
+                bindings.Clear(action);
+                axis_bindings.Set(action, code);
+                const int axis = AxisBindings::Axis(code);
+                if (axis < 8) {
+                    return AxisBindings::Name(code);
+                }
+                static const char* const directions[] = {"Right", "Left", "Down", "Up"};
+                return "POV " + std::to_string((axis - 8) / 2 + 1) + " " + directions[(axis - 8) % 2 * 2 + (code & 1)];
+            }
         }
 
         return "";
     }
 
-    Action GetState() override {
-        if (device == nullptr) {
-            return {};
-        }
+    int GetBinding(Action action) const override {
+        const int button = bindings.Find(action);
+        return button >= 0 ? button : axis_bindings.Find(action);
+    }
 
-        Action res{};
-        DIJOYSTATE2 state;
-        if (device->GetDeviceState(sizeof(state), reinterpret_cast<LPVOID>(&state)) == DI_OK) {
-            for (auto& pair : bindings) {
-                if (state.rgbButtons[pair.second]) {
-                    res = static_cast<Action>(res | pair.first);
-                }
+    bool SetBinding(Action action, int code) override {
+        if (AxisBindings::IsCode(code)) {
+            if (static_cast<size_t>(AxisBindings::Axis(code)) >= DINPUT_AXES) {
+                return false;
             }
+            bindings.Clear(action);
+            axis_bindings.Set(action, code);
+            return true;
         }
+        if (code < 0 || code >= static_cast<int>(std::size(DIJOYSTATE2{}.rgbButtons))) {
+            return false;
+        }
+        bindings.Set(action, code);
+        axis_bindings.Clear(action);
+        return true;
+    }
 
-        return res;
+    void SetAxisThreshold(const AxisThreshold& new_threshold) override {
+        threshold = new_threshold;
+        axis_bindings.SetThreshold(threshold);
+    }
+
+    Action GetState() override {
+        Refresh();
+        return state;
+    }
+
+    PollFunction PollGroup() const override {
+        return [] {
+            for (auto& controller : controllers) {
+                controller->Refresh();
+            }
+        };
+    }
+
+    Action PolledState() const override {
+        return state;
+    }
+
+    SampleLoop Loop() const override {
+        return &Sampler::Loop<DInputController>;
     }
 
 private:
-    std::map<Action, size_t> bindings;
+    void Refresh() {
+        DIJOYSTATE2 dstate;
+        if (device != nullptr && device->GetDeviceState(sizeof(dstate), reinterpret_cast<LPVOID>(&dstate)) == DI_OK) {
+            state = bindings.Evaluate(dstate.rgbButtons, std::size(dstate.rgbButtons));
+            if (!axis_bindings.Empty()) {
+                int16_t axes[DINPUT_AXES];
+                dinput_axes(dstate, axes);
+                state = static_cast<Action>(state | axis_bindings.Evaluate(axes, DINPUT_AXES));
+            }
+        } else {
+            state = {};
+        }
+    }
+
+    ButtonBindings bindings;
+    AxisBindings axis_bindings;
+    AxisThreshold threshold;
+    int16_t rest[DINPUT_AXES]{};
     LPDIRECTINPUTDEVICE8 device = nullptr;
+    Action state{};
 };
 
 Controller* dinput_open(const GUID& guidInstance) {
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include "edge_output.h"
+
+static const char* const GRADE_NAMES[] = {"red", "yellow", "green"};
+
+EdgeOutput::~EdgeOutput() {
+    Close();
+}
+
+bool EdgeOutput::Open(const std::string& path, OutputFormat new_format, const Controller::Clock::time_point& new_start) {
+    Close();
+
+    file = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    // Chunks are written whole; stdout keeps its buffer for everyone else
+    // and is flushed after each chunk instead.
+    if (file != stdout) {
+        std::setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    format = new_format;
+    start = new_start;
+    start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()
+        - std::chrono::duration_cast<std::chrono::nanoseconds>(Controller::Clock::now() - start).count();
+
+    if (format == OutputFormat::Csv) {
+        Put("time_ns,device,event,action,edge,interval_ns,grade\n");
+    }
+    return true;
+}
+
+void EdgeOutput::Put(const char* text, size_t length) {
+    std::memcpy(buffer + size, text, length);
+    size += length;
+}
+
+void EdgeOutput::Put(const char* text) {
+    Put(text, std::strlen(text));
+}
+
+void EdgeOutput::PutInt(int64_t value) {
+    const auto res = std::to_chars(buffer + size, buffer + sizeof(buffer), value);
+    size = static_cast<size_t>(res.ptr - buffer);
+}
+
+// Technique names come from the rules file; quotes and backslashes are
+// escaped for JSON, CSV fields with separators are quoted.
+void EdgeOutput::PutName(const char* name) {
+    const auto length = std::min(std::strlen(name), RECORD_MAX / 4);
+    const bool quote = format == OutputFormat::JsonLines || std::strpbrk(name, ",\"\n") != nullptr;
+    if (quote) {
+        buffer[size++] = '"';
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (name[i] == '"') {
+            buffer[size++] = format == OutputFormat::JsonLines ? '\\' : '"';
+        } else if (name[i] == '\\' && format == OutputFormat::JsonLines) {
+            buffer[size++] = '\\';
+        }
+        buffer[size++] = name[i];
+    }
+    if (quote) {
+        buffer[size++] = '"';
+    }
+}
+
+void EdgeOutput::Append(const EdgeRecord& record) {
+    if (file == nullptr) {
+        return;
+    }
+    if (size + RECORD_MAX > sizeof(buffer)) {
+        Flush();
+    }
+    if (size == 0) {
+        first_pending = record.time;
+    }
+
+    const auto time_ns = start_unix_ns + std::chrono::duration_cast<std::chrono::nanoseconds>(record.time - start).count();
+    const auto interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(record.interval).count();
+    const char* edge = record.press ? "press" : "release";
+    const char* grade = GRADE_NAMES[static_cast<int>(record.grade)];
+
+    if (format == OutputFormat::JsonLines) {
+        Put("{\"time_ns\":");
+        PutInt(time_ns);
+        Put(",\"device\":");
+        PutInt(record.device);
+        Put(",\"event\":");
+        PutInt(record.event_id);
+        Put(",\"action\":");
+        PutName(record.action);
+        Put(",\"edge\":\"");
+        Put(edge);
+        Put("\",\"interval_ns\":");
+        PutInt(interval_ns);
+        Put(",\"grade\":\"");
+        Put(grade);
+        Put("\"}\n");
+    } else {
+        PutInt(time_ns);
+        Put(",");
+        PutInt(record.device);
+        Put(",");
+        PutInt(record.event_id);
+        Put(",");
+        PutName(record.action);
+        Put(",");
+        Put(edge);
+        Put(",");
+        PutInt(interval_ns);
+        Put(",");
+        Put(grade);
+        Put("\n");
+    }
+}
+
+void EdgeOutput::Tick(const Controller::Clock::time_point& now) {
+    if (size > 0 && now - first_pending >= FLUSH_INTERVAL) {
+        Flush();
+    }
+}
+
+void EdgeOutput::Flush() {
+    if (file != nullptr && size > 0) {
+        std::fwrite(buffer, 1, size, file);
+        if (file == stdout) {
+            std::fflush(file);
+        }
+    }
+    size = 0;
+}
+
+void EdgeOutput::Close() {
+    if (file != nullptr) {
+        Flush();
+        if (file != stdout) {
+            std::fclose(file);
+        }
+        file = nullptr;
+    }
+}
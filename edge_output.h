@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "controller.h"
+#include "grading.h"
+
+// Graded edges as machine-readable records, one per line:
+//   {"time_ns":1700000000123456789,"device":0,"event":12,"action":"Dash","edge":"release","interval_ns":83412000,"grade":"green"}
+//   time_ns,device,event,action,edge,interval_ns,grade
+// Times are Unix nanoseconds; the interval is the time since the previous
+// edge of the same action, so a release carries how long it was held.
+enum class OutputFormat {
+    JsonLines,
+    Csv
+};
+
+struct EdgeRecord {
+    Controller::Clock::time_point time;
+    uint32_t device;
+    unsigned int event_id;
+    const char* action;
+    bool press;
+    Controller::Clock::duration interval;
+    Grade grade;
+};
+
+// Formats records straight into a fixed buffer and writes it out in large
+// chunks: when it fills up, on Flush(), or from Tick() once the oldest
+// pending record is older than the flush interval.
+class EdgeOutput {
+public:
+    EdgeOutput() = default;
+    ~EdgeOutput();
+
+    EdgeOutput(const EdgeOutput&) = delete;
+    EdgeOutput& operator=(const EdgeOutput&) = delete;
+
+    // "-" writes to stdout.
+    bool Open(const std::string& path, OutputFormat format, const Controller::Clock::time_point& start);
+    void Append(const EdgeRecord& record);
+    void Tick(const Controller::Clock::time_point& now);
+    void Flush();
+    void Close();
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+    bool IsStdout() const {
+        return file == stdout;
+    }
+
+private:
+    static constexpr size_t RECORD_MAX = 512;
+    static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(100);
+
+    void Put(const char* text, size_t length);
+    void Put(const char* text);
+    void PutInt(int64_t value);
+    void PutName(const char* name);
+
+    std::FILE* file = nullptr;
+    OutputFormat format = OutputFormat::JsonLines;
+    Controller::Clock::time_point start;
+    int64_t start_unix_ns = 0;
+    Controller::Clock::time_point first_pending;
+
+    char buffer[65536];
+    size_t size = 0;
+};
@@ -0,0 +1,594 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <linux/input.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binding.h"
+#include "evdev.h"
+#include "sampler.h"
+
+static int epoll_fd = -1;
+static int inotify_fd = -1;
+
+class EvdevController;
+static std::list<std::unique_ptr<EvdevController>> controllers;
+
+bool evdev_init() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        return false;
+    }
+
+    // Device nodes appear before udev grants access to them, so a node is
+    // retried when its attributes change. Without inotify devices that are
+    // unplugged just stay released.
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        if (inotify_add_watch(inotify_fd, "/dev/input", IN_CREATE | IN_ATTRIB) < 0
+            || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inotify_fd, &event) != 0) {
+            close(inotify_fd);
+            inotify_fd = -1;
+        }
+    }
+    return true;
+}
+
+void evdev_exit() {
+    controllers.clear();
+
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+    inotify_fd = -1;
+
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    epoll_fd = -1;
+}
+
+static bool test_bit(const unsigned char* bits, int bit) {
+    return (bits[bit / 8] >> (bit % 8)) & 1;
+}
+
+void evdev_enum(const evdev_enum_cb& callback) {
+    if (epoll_fd < 0) {
+        return;
+    }
+
+    DIR* dir = opendir("/dev/input");
+    if (dir == nullptr) {
+        return;
+    }
+
+    std::vector<int> numbers;
+    while (auto entry = readdir(dir)) {
+        int number;
+        if (std::sscanf(entry->d_name, "event%d", &number) == 1) {
+            numbers.push_back(number);
+        }
+    }
+    closedir(dir);
+    std::sort(numbers.begin(), numbers.end());
+
+    for (auto number : numbers) {
+        const auto path = "/dev/input/event" + std::to_string(number);
+        const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        unsigned char keys[KEY_CNT / 8 + 1]{};
+        char name[256]{};
+        bool joystick = false;
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) >= 0) {
+            for (int code = BTN_JOYSTICK; code <= BTN_THUMBR && !joystick; ++code) {
+                joystick = test_bit(keys, code);
+            }
+        }
+        if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 0) {
+            std::strcpy(name, "Unknown");
+        }
+        close(fd);
+
+        if (joystick) {
+            callback(path, name);
+        }
+    }
+}
+
+static const std::map<int, std::string_view> EVDEV_BUTTONS{
+    {BTN_A, "A"},
+    {BTN_B, "B"},
+    {BTN_C, "C"},
+    {BTN_X, "X"},
+    {BTN_Y, "Y"},
+    {BTN_Z, "Z"},
+    {BTN_TL, "TL"},
+    {BTN_TR, "TR"},
+    {BTN_TL2, "TL2"},
+    {BTN_TR2, "TR2"},
+    {BTN_SELECT, "Select"},
+    {BTN_START, "Start"},
+    {BTN_MODE, "Mode"},
+    {BTN_THUMBL, "Thumb L"},
+    {BTN_THUMBR, "Thumb R"},
+    {BTN_DPAD_UP, "D-Pad Up"},
+    {BTN_DPAD_DOWN, "D-Pad Down"},
+    {BTN_DPAD_LEFT, "D-Pad Left"},
+    {BTN_DPAD_RIGHT, "D-Pad Right"}
+};
+
+static const std::map<int, std::string_view> EVDEV_AXES{
+    {ABS_X, "X"},
+    {ABS_Y, "Y"},
+    {ABS_Z, "Z"},
+    {ABS_RX, "RX"},
+    {ABS_RY, "RY"},
+    {ABS_RZ, "RZ"},
+    {ABS_GAS, "Gas"},
+    {ABS_BRAKE, "Brake"},
+    {ABS_HAT0X, "Hat X"},
+    {ABS_HAT0Y, "Hat Y"}
+};
+
+class EvdevController final : public Controller {
+public:
+    EvdevController(const std::string& path) : Controller() {
+        fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st;
+        device = fstat(fd, &st) == 0 && S_ISCHR(st.st_mode);
+        if (device) {
+            identity = Identity(fd);
+            Setup();
+        }
+        // Whatever the axes read when opened is taken as their rest.
+        rest = axes;
+
+        // Regular files cannot be registered with epoll, they are always read.
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = this;
+        polled = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+        attached = true;
+    }
+
+    ~EvdevController() {
+        if (fd >= 0) {
+            if (polled) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            }
+            close(fd);
+        }
+    }
+
+    bool IsOpen() const {
+        return fd >= 0;
+    }
+
+    bool IsPolled() const {
+        return polled;
+    }
+
+    std::string BindAction(Action action) override {
+        Update(0);
+        edges.clear();
+        for (int code = 0; code < KEY_CNT; ++code) {
+            if (pressed[code]) {
+                bindings.Set(action, code);
+                axis_bindings.Clear(action);
+                state = Evaluate();
+
+                const auto it = EVDEV_BUTTONS.find(code);
+                if (it != EVDEV_BUTTONS.end()) {
+                    return std::string(it->second);
+                }
+                return "Key " + std::to_string(code);
+            }
+        }
+
+        const int code = AxisBindings::Detect(axes.data(), rest.data(), axes.size(), threshold);
+        if (code >= 0) {
+            bindings.Clear(action);
+            axis_bindings.Set(action, code);
+            state = Evaluate();
+
+            const auto it = EVDEV_AXES.find(AxisBindings::Axis(code));
+            if (it != EVDEV_AXES.end()) {
+                return std::string(it->second) + ((code & 1) ? "-" : "+");
+            }
+            return AxisBindings::Name(code);
+        }
+        return "";
+    }
+
+    int GetBinding(Action action) const override {
+        const int button = bindings.Find(action);
+        return button >= 0 ? button : axis_bindings.Find(action);
+    }
+
+    bool SetBinding(Action action, int code) override {
+        if (AxisBindings::IsCode(code)) {
+            if (AxisBindings::Axis(code) >= ABS_CNT) {
+                return false;
+            }
+            bindings.Clear(action);
+            axis_bindings.Set(action, code);
+        } else {
+            if (code < 0 || code >= KEY_CNT) {
+                return false;
+            }
+            bindings.Set(action, code);
+            axis_bindings.Clear(action);
+        }
+        state = Evaluate();
+        return true;
+    }
+
+    void SetAxisThreshold(const AxisThreshold& new_threshold) override {
+        threshold = new_threshold;
+        axis_bindings.SetThreshold(threshold);
+    }
+
+    Action GetState() override {
+        Update(0);
+        return state;
+    }
+
+    // One epoll pass reads every device that has input.
+    PollFunction PollGroup() const override {
+        return [] {
+            Update(0);
+        };
+    }
+
+    Action PolledState() const override {
+        return state;
+    }
+
+    SampleLoop Loop() const override {
+        return &Sampler::Loop<EvdevController>;
+    }
+
+    bool PopEdge(Edge& edge) override {
+        if (edges.empty()) {
+            return false;
+        }
+        edge = edges.front();
+        edges.pop_front();
+        return true;
+    }
+
+    void WaitInput(std::chrono::microseconds timeout) override {
+        const auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+        if (!WaitsForInput() || timeout_ms <= 0) {
+            Controller::WaitInput(timeout);
+            return;
+        }
+
+        epoll_event event;
+        epoll_wait(epoll_fd, &event, 1, static_cast<int>(timeout_ms));
+    }
+
+    bool WaitsForInput() const override {
+        return device && (polled || fd < 0);
+    }
+
+    bool Attached() const override {
+        return attached;
+    }
+
+    // Character devices are drained completely. Pipes and regular files
+    // holding a recorded stream are played back in real time, one
+    // SYN_REPORT frame at a time once its timestamp is due.
+    void Read() {
+        if (fd < 0) {
+            return;
+        }
+
+        ssize_t size;
+        if (device) {
+            input_event events[64];
+            while ((size = read(fd, events, sizeof(events))) > 0) {
+                for (size_t i = 0; i < static_cast<size_t>(size) / sizeof(input_event); ++i) {
+                    Process(events[i]);
+                }
+            }
+            if (size < 0 && errno == ENODEV) {
+                Unplug();
+            } else if (size == 0 || errno != EAGAIN) {
+                Detach();
+            }
+            return;
+        }
+
+        for (;;) {
+            if (partial_size < sizeof(partial)) {
+                size = read(fd, reinterpret_cast<char*>(&partial) + partial_size, sizeof(partial) - partial_size);
+                if (size <= 0) {
+                    if (size == 0 || errno != EAGAIN) {
+                        Detach();
+                    }
+                    return;
+                }
+                partial_size += static_cast<size_t>(size);
+                continue;
+            }
+
+            if (partial.type == EV_SYN && partial.code == SYN_REPORT && EventTime(partial) > Clock::now()) {
+                return;
+            }
+            partial_size = 0;
+            Process(partial);
+        }
+    }
+
+    // Hands a device node that showed up to the unplugged controller it
+    // belongs to. The node may come back under another number.
+    bool Reattach(int new_fd, const std::string& new_identity) {
+        if (fd >= 0 || !device || new_identity != identity) {
+            return false;
+        }
+
+        fd = new_fd;
+        Setup();
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = this;
+        polled = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+        attached = true;
+
+        const auto new_state = Evaluate();
+        if (new_state != state) {
+            state = new_state;
+            edges.push_back({Clock::now(), state});
+        }
+        return true;
+    }
+
+    static void Update(int timeout_ms);
+
+private:
+    static void Hotplug();
+
+    // Devices are told apart by bus, ids, name and unique id, not by node.
+    static std::string Identity(int fd) {
+        input_id id{};
+        char name[256]{};
+        char uniq[256]{};
+        ioctl(fd, EVIOCGID, &id);
+        ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+        ioctl(fd, EVIOCGUNIQ(sizeof(uniq) - 1), uniq);
+
+        char ids[32];
+        std::snprintf(ids, sizeof(ids), "%04x:%04x:%04x:%04x:", id.bustype, id.vendor, id.product, id.version);
+        return std::string(ids) + name + ":" + uniq;
+    }
+
+    void Setup() {
+        int clock = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+        dropped = false;
+        Resync();
+    }
+    // Devices report CLOCK_MONOTONIC, the epoch of steady_clock and so of
+    // Clock. Recorded streams are rebased so that their first frame happens
+    // now.
+    Clock::time_point EventTime(const input_event& event) {
+        const auto time = Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::seconds(event.input_event_sec) + std::chrono::microseconds(event.input_event_usec)));
+        if (device) {
+            return time;
+        }
+        if (!rebased) {
+            stream_offset = Clock::now() - time;
+            rebased = true;
+        }
+        return time + stream_offset;
+    }
+
+    // A closed pipe or a removed device stays readable forever, keep it
+    // out of epoll so waiting does not turn into spinning.
+    void Detach() {
+        if (polled) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            polled = false;
+        }
+    }
+
+    // The device is gone: its buttons read as released until it is back.
+    void Unplug() {
+        Detach();
+        close(fd);
+        fd = -1;
+        attached = false;
+        pressed.reset();
+        axes = rest;
+        if (state != Action{}) {
+            state = {};
+            edges.push_back({Clock::now(), state});
+        }
+    }
+
+    void Process(const input_event& event) {
+        if (event.type == EV_SYN && event.code == SYN_DROPPED) {
+            dropped = true;
+        } else if (event.type == EV_KEY && event.code < KEY_CNT && event.value != 2 && !dropped) {
+            pressed[event.code] = event.value != 0;
+        } else if (event.type == EV_ABS && event.code < ABS_CNT && !dropped) {
+            axes[event.code] = Normalize(event.code, event.value);
+        } else if (event.type == EV_SYN && event.code == SYN_REPORT) {
+            if (dropped) {
+                dropped = false;
+                Resync();
+            }
+            const auto new_state = Evaluate();
+            if (new_state != state) {
+                state = new_state;
+                edges.push_back({EventTime(event), state});
+            }
+        }
+    }
+
+    void Resync() {
+        unsigned char keys[KEY_CNT / 8 + 1]{};
+        if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+            for (int code = 0; code < KEY_CNT; ++code) {
+                pressed[code] = test_bit(keys, code);
+            }
+        }
+
+        unsigned char abs_bits[ABS_CNT / 8 + 1]{};
+        if (ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) >= 0) {
+            for (int code = 0; code < ABS_CNT; ++code) {
+                input_absinfo info{};
+                if (test_bit(abs_bits, code) && ioctl(fd, EVIOCGABS(code), &info) >= 0) {
+                    ranges[code] = {info.minimum, info.maximum};
+                    axes[code] = Normalize(code, info.value);
+                }
+            }
+        }
+    }
+
+    // Axes are scaled from their reported range to int16, so thresholds
+    // mean the same on every device. Without a range values are clamped.
+    int16_t Normalize(int code, int32_t value) const {
+        const auto& range = ranges[code];
+        int64_t scaled = value;
+        if (range.second > range.first) {
+            scaled = (static_cast<int64_t>(value) - range.first) * 65535 / (range.second - range.first) - 32768;
+        }
+        return static_cast<int16_t>(std::clamp<int64_t>(scaled, -32768, 32767));
+    }
+
+    Action Evaluate() {
+        auto res = bindings.Evaluate([&](int code) {
+            return pressed[code];
+        });
+        if (!axis_bindings.Empty()) {
+            res = static_cast<Action>(res | axis_bindings.Evaluate(axes.data(), axes.size()));
+        }
+        return res;
+    }
+
+    ButtonBindings bindings;
+    AxisBindings axis_bindings;
+    AxisThreshold threshold;
+    int fd = -1;
+    bool device = false;
+    bool polled = false;
+    std::string identity;
+    std::atomic<bool> attached{false};
+
+    std::bitset<KEY_CNT> pressed;
+    std::array<int16_t, ABS_CNT> axes{};
+    std::array<int16_t, ABS_CNT> rest{};
+    std::array<std::pair<int32_t, int32_t>, ABS_CNT> ranges{};
+    bool dropped = false;
+    input_event partial{};
+    size_t partial_size = 0;
+    Clock::duration stream_offset{};
+    bool rebased = false;
+
+    std::deque<Edge> edges;
+    Action state{};
+};
+
+void EvdevController::Update(int timeout_ms) {
+    epoll_event events[16];
+    const int count = epoll_wait(epoll_fd, events, static_cast<int>(std::size(events)), timeout_ms);
+    for (int i = 0; i < count; ++i) {
+        if (events[i].data.ptr == nullptr) {
+            Hotplug();
+        } else {
+            static_cast<EvdevController*>(events[i].data.ptr)->Read();
+        }
+    }
+
+    for (auto& controller : controllers) {
+        if (!controller->IsPolled()) {
+            controller->Read();
+        }
+    }
+}
+
+void EvdevController::Hotplug() {
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t offset = 0; offset < size;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            int number;
+            if (event->len == 0 || std::sscanf(event->name, "event%d", &number) != 1) {
+                continue;
+            }
+            const bool missing = std::any_of(controllers.begin(), controllers.end(), [](const auto& controller) {
+                return controller->device && controller->fd < 0;
+            });
+            if (!missing) {
+                continue;
+            }
+
+            const auto path = std::string("/dev/input/") + event->name;
+            const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            const auto identity = Identity(fd);
+            const bool taken = std::any_of(controllers.begin(), controllers.end(), [&](const auto& controller) {
+                return controller->Reattach(fd, identity);
+            });
+            if (!taken) {
+                close(fd);
+            }
+        }
+    }
+}
+
+Controller* evdev_open(const std::string& path) {
+    if (epoll_fd < 0) {
+        return nullptr;
+    }
+
+    auto controller = std::make_unique<EvdevController>(path);
+    if (!controller->IsOpen()) {
+        return nullptr;
+    }
+
+    return &*controllers.emplace_back(std::move(controller));
+}
+
+void evdev_close(const Controller* controller) {
+    controllers.remove_if([&](auto& ptr) {
+        return ptr.get() == controller; }
+    );
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "controller.h"
+
+bool evdev_init();
+void evdev_exit();
+
+using evdev_enum_cb = std::function<void(const std::string& path, const std::string& name)>;
+void evdev_enum(const evdev_enum_cb& callback);
+
+Controller* evdev_open(const std::string& path);
+
+void evdev_close(const Controller* controller);
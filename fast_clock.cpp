@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+#include "fast_clock.h"
+
+#ifdef FAST_CLOCK_TSC
+
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
+
+// Errors up to this are slewed out over the next check interval. Falling
+// further behind, after a suspend or a VM migration, is stepped forward;
+// running further ahead is slewed out over twice the lead.
+static constexpr int64_t SLEW_NS = 1000000000;
+static constexpr int64_t STEP_NS = 1000000;
+
+// Where calibration started; the rate is always taken over the whole span
+// since, so it only gets more accurate.
+static uint64_t base_ticks;
+static int64_t base_ns;
+
+static bool has_invariant_tsc() {
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if (static_cast<unsigned int>(regs[0]) < 0x80000007) {
+        return false;
+    }
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8)) != 0;
+#endif
+}
+
+// A TSC reading paired with steady_clock, taken as the middle of the
+// tightest of a few brackets.
+static void sample(uint64_t& ticks, int64_t& ns) {
+    uint64_t best = std::numeric_limits<uint64_t>::max();
+    ticks = 0;
+    ns = 0;
+    for (int i = 0; i < 7; ++i) {
+        unsigned int aux;
+        const auto before = __rdtscp(&aux);
+        const auto time = std::chrono::steady_clock::now();
+        const auto after = __rdtscp(&aux);
+        if (after - before < best) {
+            best = after - before;
+            ticks = before + (after - before) / 2;
+            ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+    }
+}
+
+bool FastClock::Calibrate() {
+    if (!has_invariant_tsc()) {
+        return false;
+    }
+
+    sample(base_ticks, base_ns);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t ticks;
+    int64_t ns;
+    sample(ticks, ns);
+
+    const double rate = static_cast<double>(ns - base_ns) / static_cast<double>(ticks - base_ticks);
+    // Anything outside 10 MHz to 100 GHz is not a TSC worth trusting.
+    if (!(rate > 0.01 && rate < 100.0)) {
+        return false;
+    }
+
+    anchor_ticks.store(ticks, std::memory_order_relaxed);
+    anchor_ns.store(ns, std::memory_order_relaxed);
+    ns_per_tick.store(rate, std::memory_order_relaxed);
+    calibrated.store(true, std::memory_order_release);
+    return true;
+}
+
+FastClock::duration FastClock::Check() {
+    if (!calibrated.load(std::memory_order_acquire)) {
+        return duration::zero();
+    }
+
+    uint64_t ticks;
+    int64_t ns;
+    sample(ticks, ns);
+    const auto error = FromTicks(ticks) - ns;
+    max_drift.store(std::max(max_drift.load(std::memory_order_relaxed), std::abs(error)), std::memory_order_relaxed);
+
+    const double rate = static_cast<double>(ns - base_ns) / static_cast<double>(ticks - base_ticks);
+    const auto sequence = scale_sequence.load(std::memory_order_relaxed);
+    scale_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (error > -STEP_NS) {
+        // Stays continuous and runs a little fast or slow until the error
+        // is gone, so time never goes backwards. A large lead is worked off
+        // at no less than half speed.
+        const auto span = static_cast<double>(std::max(SLEW_NS, 2 * error));
+        anchor_ns.store(ns + error, std::memory_order_relaxed);
+        ns_per_tick.store(rate * (span - static_cast<double>(error)) / span, std::memory_order_relaxed);
+    } else {
+        anchor_ns.store(ns, std::memory_order_relaxed);
+        ns_per_tick.store(rate, std::memory_order_relaxed);
+    }
+    anchor_ticks.store(ticks, std::memory_order_relaxed);
+    scale_sequence.store(sequence + 2, std::memory_order_release);
+    return duration(error);
+}
+
+double FastClock::Frequency() {
+    return calibrated.load(std::memory_order_relaxed) ? 1e9 / ns_per_tick.load(std::memory_order_relaxed) : 0.0;
+}
+
+#else
+
+bool FastClock::Calibrate() {
+    return false;
+}
+
+FastClock::duration FastClock::Check() {
+    return duration::zero();
+}
+
+double FastClock::Frequency() {
+    return 0.0;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define FAST_CLOCK_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// The clock of every sample and edge. Where the CPU has an invariant TSC it
+// is read directly and scaled to nanoseconds, a few ns where a slow kernel
+// clocksource costs a microsecond or more; otherwise, and until Calibrate()
+// has run, it is steady_clock. Either way it keeps steady_clock's epoch, so
+// kernel timestamps and sleep deadlines still line up.
+//
+// Check() measures the error against steady_clock and slews the scale to
+// take it out over the next second; it has to be called from one thread.
+class FastClock {
+public:
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<FastClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+#ifdef FAST_CLOCK_TSC
+        if (calibrated.load(std::memory_order_relaxed)) {
+            return time_point(duration(FromTicks(__rdtsc())));
+        }
+#endif
+        return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+    }
+
+    // Measures the TSC rate against steady_clock, which takes about 20 ms.
+    // False when there is no invariant TSC to use.
+    static bool Calibrate();
+    // The error found before correcting it.
+    static duration Check();
+
+    static bool UsesTsc() {
+        return calibrated.load(std::memory_order_relaxed);
+    }
+
+    // Ticks per second of the TSC, 0 without one.
+    static double Frequency();
+
+    // The largest error found by Check() so far.
+    static duration MaxDrift() {
+        return duration(max_drift.load(std::memory_order_relaxed));
+    }
+
+private:
+    // Scale and anchor change together under a sequence number, odd while
+    // Check() is writing them.
+    static int64_t FromTicks(uint64_t ticks) noexcept {
+        for (;;) {
+            const auto sequence = scale_sequence.load(std::memory_order_acquire);
+            const auto base_ticks = anchor_ticks.load(std::memory_order_relaxed);
+            const auto base_ns = anchor_ns.load(std::memory_order_relaxed);
+            const auto rate = ns_per_tick.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((sequence & 1) == 0 && scale_sequence.load(std::memory_order_relaxed) == sequence) {
+                return base_ns + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ticks - base_ticks)) * rate);
+            }
+        }
+    }
+
+    static inline std::atomic<bool> calibrated{false};
+    static inline std::atomic<uint64_t> scale_sequence{0};
+    static inline std::atomic<uint64_t> anchor_ticks{0};
+    static inline std::atomic<int64_t> anchor_ns{0};
+    static inline std::atomic<double> ns_per_tick{0.0};
+    static inline std::atomic<int64_t> max_drift{0};
+};
@@ -0,0 +1,346 @@
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "feed.h"
+
+std::string feed_socket_path(const std::string& name) {
+    const char* base = std::getenv("XDG_RUNTIME_DIR");
+    return std::string(base != nullptr && *base != '\0' ? base : "/tmp") + "/" + name + ".sock";
+}
+
+static FeedRecord feed_record(const EdgeRecord& record, int64_t time_ns) {
+    FeedRecord res{};
+    res.time_ns = time_ns;
+    res.interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(record.interval).count();
+    res.device = record.device;
+    res.event_id = record.event_id;
+    res.press = record.press ? 1 : 0;
+    res.grade = static_cast<uint8_t>(record.grade);
+    std::strncpy(res.action, record.action, sizeof(res.action) - 1);
+    return res;
+}
+
+FeedPublisher::~FeedPublisher() {
+    Close();
+}
+
+FeedReader::~FeedReader() {
+    Close();
+}
+
+#ifdef _WIN32
+
+// Neither shared memory under a name nor Unix sockets are wired up here.
+bool FeedPublisher::Open(const std::string&, const Controller::Clock::time_point&) {
+    error = "not supported on this platform";
+    return false;
+}
+
+void FeedPublisher::Publish(const EdgeRecord&) {}
+void FeedPublisher::Tick() {}
+void FeedPublisher::Close() {}
+
+bool FeedReader::Open(const std::string&) {
+    return false;
+}
+
+bool FeedReader::Next(FeedRecord&) {
+    return false;
+}
+
+void FeedReader::Close() {}
+
+#else
+
+static constexpr size_t FEED_MAX_CLIENTS = 16;
+
+static size_t feed_size() {
+    return sizeof(FeedHeader) + FEED_CAPACITY * sizeof(FeedSlot);
+}
+
+// The process publishing an existing ring, 0 when it is gone or the ring
+// has another format, and -1 while the ring is not sized or its header not
+// written yet.
+static int32_t feed_ring_owner(const std::string& shm_name) {
+    const int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat info{};
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= feed_size()) {
+        memory = mmap(nullptr, sizeof(FeedHeader), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return -1;
+    }
+    const auto* header = static_cast<const FeedHeader*>(memory);
+    int32_t pid = -1;
+    if (std::memcmp(header->magic, FEED_MAGIC, sizeof(header->magic)) == 0) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        pid = header->version == FEED_VERSION ? header->pid : 0;
+    }
+    munmap(memory, sizeof(FeedHeader));
+    if (pid <= 0) {
+        return pid;
+    }
+    return kill(pid, 0) == 0 || errno == EPERM ? pid : 0;
+}
+
+bool FeedPublisher::Open(const std::string& new_name, const Controller::Clock::time_point& new_start) {
+    Close();
+    error.clear();
+    name = new_name;
+    start = new_start;
+    start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()
+        - std::chrono::duration_cast<std::chrono::nanoseconds>(Controller::Clock::now() - start).count();
+
+    const auto shm_name = "/" + name;
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    for (int attempt = 0; fd < 0 && errno == EEXIST && attempt < 50; ++attempt) {
+        const auto owner = feed_ring_owner(shm_name);
+        if (owner > 0) {
+            error = "already published by process " + std::to_string(owner);
+            return false;
+        }
+        if (owner < 0) {
+            // Another publisher has created it but not sized it or written
+            // its header yet; give it a moment.
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        } else {
+            // Left over by a crashed run.
+            shm_unlink(shm_name.c_str());
+        }
+        fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0 && errno == EEXIST) {
+        error = shm_name + " is still being set up by another process; remove it from /dev/shm if none is running";
+        return false;
+    }
+    if (fd >= 0) {
+        void* memory = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(feed_size())) == 0) {
+            memory = mmap(nullptr, feed_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (memory != MAP_FAILED) {
+            mapped_size = feed_size();
+            header = new (memory) FeedHeader{};
+            slots = reinterpret_cast<FeedSlot*>(header + 1);
+            for (size_t i = 0; i < FEED_CAPACITY; ++i) {
+                new (&slots[i]) FeedSlot{};
+            }
+            header->version = FEED_VERSION;
+            header->capacity = FEED_CAPACITY;
+            header->slot_size = sizeof(FeedSlot);
+            header->pid = static_cast<int32_t>(getpid());
+            // The magic goes in last, readers check it before anything else.
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(header->magic, FEED_MAGIC, sizeof(header->magic));
+            return true;
+        }
+        shm_unlink(shm_name.c_str());
+    }
+
+    socket_path = feed_socket_path(name);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long: " + socket_path;
+        return false;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    int bound = bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    if (bound != 0 && errno == EADDRINUSE) {
+        // A socket nobody listens on any more is left over by a crashed run.
+        const int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        const bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (live) {
+            error = "already published on " + socket_path;
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        unlink(socket_path.c_str());
+        bound = bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    }
+    if (bound != 0 || listen(listen_fd, 4) != 0) {
+        error = std::strerror(errno);
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void FeedPublisher::Publish(const EdgeRecord& record) {
+    const auto time_ns = start_unix_ns + std::chrono::duration_cast<std::chrono::nanoseconds>(record.time - start).count();
+    const auto data = feed_record(record, time_ns);
+
+    if (header != nullptr) {
+        const auto index = header->head.load(std::memory_order_relaxed);
+        auto& slot = slots[index % FEED_CAPACITY];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.record, &data, sizeof(data));
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        header->head.store(index + 1, std::memory_order_release);
+        return;
+    }
+
+    for (auto it = clients.begin(); it != clients.end();) {
+        if (send(*it, &data, sizeof(data), MSG_DONTWAIT | MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(data))) {
+            ++it;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            ++dropped;
+            ++it;
+        } else {
+            close(*it);
+            it = clients.erase(it);
+        }
+    }
+}
+
+void FeedPublisher::Tick() {
+    if (listen_fd < 0) {
+        return;
+    }
+    int client;
+    while (clients.size() < FEED_MAX_CLIENTS && (client = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        clients.push_back(client);
+    }
+}
+
+void FeedPublisher::Close() {
+    if (header != nullptr) {
+        munmap(header, mapped_size);
+        shm_unlink(("/" + name).c_str());
+        header = nullptr;
+        slots = nullptr;
+    }
+    for (const int client : clients) {
+        close(client);
+    }
+    clients.clear();
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        listen_fd = -1;
+    }
+}
+
+bool FeedReader::Open(const std::string& name) {
+    Close();
+
+    const int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+        // Touching pages past the end of a ring that is not sized yet, or
+        // belongs to another build, would raise SIGBUS.
+        struct stat info{};
+        void* memory = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= feed_size()) {
+            memory = mmap(nullptr, feed_size(), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (memory != MAP_FAILED) {
+            const auto* mapped = static_cast<const FeedHeader*>(memory);
+            if (std::memcmp(mapped->magic, FEED_MAGIC, sizeof(mapped->magic)) == 0 && mapped->version == FEED_VERSION
+                && mapped->capacity == FEED_CAPACITY && mapped->slot_size == sizeof(FeedSlot)) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                header = mapped;
+                slots = reinterpret_cast<const FeedSlot*>(header + 1);
+                mapped_size = feed_size();
+                next = header->head.load(std::memory_order_acquire);
+                return true;
+            }
+            munmap(memory, feed_size());
+        }
+    }
+
+    const auto path = feed_socket_path(name);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (socket_fd >= 0 && connect(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    return socket_fd >= 0;
+}
+
+bool FeedReader::Next(FeedRecord& record) {
+    if (socket_fd >= 0) {
+        return recv(socket_fd, &record, sizeof(record), MSG_DONTWAIT) == static_cast<ssize_t>(sizeof(record));
+    }
+    if (header == nullptr) {
+        return false;
+    }
+
+    for (;;) {
+        const auto head = header->head.load(std::memory_order_acquire);
+        if (next == head) {
+            return false;
+        }
+        if (head - next > FEED_CAPACITY) {
+            lost += head - FEED_CAPACITY - next;
+            next = head - FEED_CAPACITY;
+        }
+
+        // Copied out and checked against the slot's sequence afterwards; a
+        // changed sequence means the publisher lapped this reader meanwhile.
+        const auto& slot = slots[next % FEED_CAPACITY];
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        std::memcpy(&record, &slot.record, sizeof(record));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const auto after = slot.sequence.load(std::memory_order_relaxed);
+        ++next;
+        if (before == 2 * next && after == before) {
+            return true;
+        }
+        ++lost;
+    }
+}
+
+void FeedReader::Close() {
+    if (header != nullptr) {
+        munmap(const_cast<FeedHeader*>(header), mapped_size);
+        header = nullptr;
+        slots = nullptr;
+    }
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+}
+
+#endif
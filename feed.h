@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "edge_output.h"
+
+// Live feed of graded edges for local consumers such as overlays. The
+// publisher writes into a shared-memory ring that any number of readers map
+// read-only and follow at their own pace; nobody ever waits on a reader; a
+// reader that falls a full ring behind loses the oldest records and is
+// told how many. Each slot is guarded by a sequence number, odd while it
+// is being written, so a reader can tell a torn copy from a good one.
+//
+// Where shared memory is unavailable the publisher serves the same records
+// over a Unix seqpacket socket instead, dropping them for clients whose
+// socket buffer is full.
+//
+// A feed name belongs to one running publisher; a second one under the
+// same name fails to open rather than taking the feed over. Rings and
+// sockets left behind by a crash are reclaimed.
+constexpr char FEED_MAGIC[4] = {'H', 'P', 'F', 'D'};
+constexpr uint32_t FEED_VERSION = 2;
+constexpr uint32_t FEED_CAPACITY = 1024;
+
+struct FeedRecord {
+    int64_t time_ns;
+    int64_t interval_ns;
+    uint32_t device;
+    uint32_t event_id;
+    uint8_t press;
+    uint8_t grade;
+    char action[22];
+};
+static_assert(sizeof(FeedRecord) == 48, "FeedRecord must stay 48 bytes");
+
+struct FeedSlot {
+    std::atomic<uint64_t> sequence;
+    FeedRecord record;
+};
+
+struct FeedHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t slot_size;
+    // The publisher, so that a ring left behind by a crash can be told
+    // from a live one.
+    int32_t pid;
+    std::atomic<uint64_t> head;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the feed needs lock-free 64-bit atomics");
+
+class FeedPublisher {
+public:
+    FeedPublisher() = default;
+    ~FeedPublisher();
+
+    FeedPublisher(const FeedPublisher&) = delete;
+    FeedPublisher& operator=(const FeedPublisher&) = delete;
+
+    bool Open(const std::string& name, const Controller::Clock::time_point& start);
+    void Publish(const EdgeRecord& record);
+    // Takes in new socket clients; cheap when there are none.
+    void Tick();
+    void Close();
+
+    bool IsOpen() const {
+        return header != nullptr || listen_fd >= 0;
+    }
+
+    bool UsesSocket() const {
+        return listen_fd >= 0;
+    }
+
+    uint64_t Dropped() const {
+        return dropped;
+    }
+
+    // Why Open() failed.
+    const std::string& Error() const {
+        return error;
+    }
+
+private:
+    std::string name;
+    std::string error;
+    int64_t start_unix_ns = 0;
+    Controller::Clock::time_point start;
+
+    FeedHeader* header = nullptr;
+    FeedSlot* slots = nullptr;
+    size_t mapped_size = 0;
+
+    std::string socket_path;
+    int listen_fd = -1;
+    std::vector<int> clients;
+    uint64_t dropped = 0;
+};
+
+class FeedReader {
+public:
+    FeedReader() = default;
+    ~FeedReader();
+
+    FeedReader(const FeedReader&) = delete;
+    FeedReader& operator=(const FeedReader&) = delete;
+
+    // Maps the ring when there is one, else connects to the socket. Reading
+    // starts at the newest record.
+    bool Open(const std::string& name);
+    // Never blocks; false when there is nothing new.
+    bool Next(FeedRecord& record);
+    void Close();
+
+    bool UsesSocket() const {
+        return socket_fd >= 0;
+    }
+
+    uint64_t Lost() const {
+        return lost;
+    }
+
+private:
+    const FeedHeader* header = nullptr;
+    const FeedSlot* slots = nullptr;
+    size_t mapped_size = 0;
+    uint64_t next = 0;
+
+    int socket_fd = -1;
+    uint64_t lost = 0;
+};
+
+// Where the socket of a feed lives: $XDG_RUNTIME_DIR, else /tmp.
+std::string feed_socket_path(const std::string& name);
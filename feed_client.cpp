@@ -0,0 +1,42 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "feed.h"
+
+static const char* const GRADE_NAMES[] = {"red", "yellow", "green"};
+
+// Reference consumer of the live feed: prints every record as one line.
+int main(int argc, char* argv[]) {
+    if (argc > 2) {
+        std::cout << "Usage: " << argv[0] << " [feed name]" << std::endl;
+        return 1;
+    }
+    const std::string name = argc > 1 ? argv[1] : "hoverpractice";
+
+    FeedReader reader;
+    while (!reader.Open(name)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    std::cerr << "Following " << name << (reader.UsesSocket() ? " over its socket" : " in shared memory") << std::endl;
+
+    FeedRecord record;
+    uint64_t lost = 0;
+    for (;;) {
+        if (!reader.Next(record)) {
+            std::fflush(stdout);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (reader.Lost() != lost) {
+            std::printf("# lost %llu records\n", static_cast<unsigned long long>(reader.Lost() - lost));
+            lost = reader.Lost();
+        }
+        std::printf("%lld device=%u event=%u %.22s %s %.3fms %s\n",
+            static_cast<long long>(record.time_ns), record.device, record.event_id, record.action,
+            record.press ? "press" : "release", record.interval_ns / 1e6,
+            record.grade < 3 ? GRADE_NAMES[record.grade] : "?");
+    }
+}
@@ -0,0 +1,135 @@
+#include <fstream>
+#include <sstream>
+
+#include "grading.h"
+#include "replay.h"
+
+GradingRules grading_default_rules(unsigned int rate) {
+    GradingRules rules;
+    rules.rate = rate;
+
+    GradeTables tables;
+    switch (rate) {
+    case 60: tables = DASH_TABLES<60>; break;
+    case 120: tables = DASH_TABLES<120>; break;
+    case 144: tables = DASH_TABLES<144>; break;
+    case 240: tables = DASH_TABLES<240>; break;
+    default: tables = MakeDashTables(rate); break;
+    }
+    rules.techniques.push_back({"dash", Controller::Action::Dash, tables});
+    return rules;
+}
+
+bool parse_grade(const std::string& text, Grade& grade) {
+    if (text == "red") {
+        grade = Grade::Red;
+    } else if (text == "yellow") {
+        grade = Grade::Yellow;
+    } else if (text == "green") {
+        grade = Grade::Green;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_grade_steps(const std::vector<std::string>& tokens, std::vector<GradeStep>& steps) {
+    if (tokens.empty() || tokens.size() % 2 != 0 || tokens.size() / 2 > GradeTable::MAX_STEPS) {
+        return false;
+    }
+
+    steps.clear();
+    for (size_t i = 0; i < tokens.size(); i += 2) {
+        GradeStep step{};
+        step.exclusive = tokens[i + 1][0] == '>';
+        std::stringstream frames(tokens[i + 1].substr(step.exclusive ? 1 : 0));
+        if (!parse_grade(tokens[i], step.grade) || !(frames >> step.frames)
+            || (steps.empty() ? step.frames != 0 || step.exclusive : step.frames < steps.back().frames)) {
+            return false;
+        }
+        steps.push_back(step);
+    }
+    return true;
+}
+
+bool grading_load_rules(const std::string& path, unsigned int rate, GradingRules& rules) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    struct Rule {
+        std::string name;
+        Controller::Action action;
+        std::vector<GradeStep> down;
+        std::vector<GradeStep> up;
+    };
+    std::vector<Rule> parsed;
+    int file_rate = 60;
+    bool has_sequences = false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream stream(line);
+        std::string name;
+        if (!(stream >> name) || name[0] == '#') {
+            continue;
+        }
+
+        // Read by sequence_load_rules().
+        if (name == "sequence") {
+            has_sequences = true;
+            continue;
+        }
+
+        if (name == "rate") {
+            if (!(stream >> file_rate) || file_rate <= 0 || file_rate > static_cast<int>(MAX_RATE)) {
+                return false;
+            }
+            continue;
+        }
+
+        std::string action_text;
+        std::string direction;
+        Controller::Action action;
+        if (!(stream >> action_text >> direction) || !parse_actions(action_text, action) || action == 0
+            || (direction != "down" && direction != "up")) {
+            return false;
+        }
+
+        std::vector<std::string> tokens;
+        for (std::string token; stream >> token;) {
+            tokens.push_back(token);
+        }
+        std::vector<GradeStep> steps;
+        if (!parse_grade_steps(tokens, steps)) {
+            return false;
+        }
+
+        auto rule = parsed.begin();
+        while (rule != parsed.end() && rule->name != name) {
+            ++rule;
+        }
+        if (rule == parsed.end()) {
+            rule = parsed.insert(parsed.end(), {name, action,
+                {std::begin(DASH_DOWN_STEPS), std::end(DASH_DOWN_STEPS)},
+                {std::begin(DASH_UP_STEPS), std::end(DASH_UP_STEPS)}});
+        }
+        rule->action = action;
+        (direction == "down" ? rule->down : rule->up) = std::move(steps);
+    }
+
+    rules.rate = rate != 0 ? rate : static_cast<unsigned int>(file_rate);
+    // A file of sequences alone keeps the dash.
+    if (parsed.empty() && has_sequences) {
+        rules = grading_default_rules(rules.rate);
+        return true;
+    }
+    rules.techniques.clear();
+    for (const auto& rule : parsed) {
+        rules.techniques.push_back({rule.name, rule.action, {
+            GradeTable(rule.down.data(), rule.down.size(), rules.rate),
+            GradeTable(rule.up.data(), rule.up.size(), rules.rate)}});
+    }
+    return !rules.techniques.empty();
+}
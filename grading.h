@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "controller.h"
+
+enum class Grade {
+    Red,
+    Yellow,
+    Green
+};
+
+// One step of a grading rule: intervals from `frames` on get `grade`, up
+// to the next step. Exclusive steps start just after `frames`.
+struct GradeStep {
+    Grade grade;
+    double frames;
+    bool exclusive;
+};
+
+// A grading rule compiled for one refresh rate into integer nanosecond
+// boundaries. Unused boundaries are never reached.
+class GradeTable {
+public:
+    static constexpr size_t MAX_STEPS = 8;
+
+    constexpr GradeTable() = default;
+
+    constexpr GradeTable(const GradeStep* steps, size_t count, unsigned int rate) {
+        const auto frame_ns = static_cast<int64_t>(1000000000 / rate);
+        for (size_t i = 0; i < MAX_STEPS; ++i) {
+            grades[i] = steps[i < count ? i : count - 1].grade;
+        }
+        for (size_t i = 1; i < count; ++i) {
+            const auto ns = static_cast<double>(frame_ns) * steps[i].frames;
+            const auto floor = static_cast<int64_t>(ns);
+            boundaries[i - 1] = steps[i].exclusive ? floor + 1 : (static_cast<double>(floor) < ns ? floor + 1 : floor);
+        }
+    }
+
+    constexpr Grade Lookup(int64_t ns) const {
+        size_t index = 0;
+        for (const auto boundary : boundaries) {
+            index += ns >= boundary ? 1 : 0;
+        }
+        return grades[index];
+    }
+
+private:
+    std::array<int64_t, MAX_STEPS - 1> boundaries{
+        INT64_MAX, INT64_MAX, INT64_MAX, INT64_MAX, INT64_MAX, INT64_MAX, INT64_MAX};
+    std::array<Grade, MAX_STEPS> grades{};
+};
+
+// Grades the time a button spent down (isdown) or up since its last edge.
+struct GradeTables {
+    GradeTable down;
+    GradeTable up;
+
+    Grade Evaluate(bool isdown, Controller::Clock::duration delta_time) const {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delta_time).count();
+        return (isdown ? down : up).Lookup(ns);
+    }
+};
+
+constexpr GradeStep DASH_DOWN_STEPS[] = {
+    {Grade::Green, 0, false},
+    {Grade::Red, 32, false},
+};
+
+constexpr GradeStep DASH_UP_STEPS[] = {
+    {Grade::Red, 0, false},
+    {Grade::Yellow, 0.2, false},
+    {Grade::Green, 0.5, false},
+    {Grade::Yellow, 1, true},
+    {Grade::Red, 1.3, false},
+};
+
+constexpr GradeTables MakeDashTables(unsigned int rate) {
+    return {
+        GradeTable(DASH_DOWN_STEPS, std::size(DASH_DOWN_STEPS), rate),
+        GradeTable(DASH_UP_STEPS, std::size(DASH_UP_STEPS), rate)};
+}
+
+// Built at compile time for the common refresh rates.
+template <unsigned int Rate>
+constexpr GradeTables DASH_TABLES = MakeDashTables(Rate);
+
+// Boundaries are rounded up to whole nanoseconds in double precision, so
+// they can sit a nanosecond or two from the old float comparisons (1.3
+// frames at 60 Hz was 21666664 ns there). These pin the intended ones.
+static_assert(DASH_TABLES<60>.down.Lookup(533333311) == Grade::Green);
+static_assert(DASH_TABLES<60>.down.Lookup(533333312) == Grade::Red);
+static_assert(DASH_TABLES<60>.up.Lookup(3333333) == Grade::Red);
+static_assert(DASH_TABLES<60>.up.Lookup(3333334) == Grade::Yellow);
+static_assert(DASH_TABLES<60>.up.Lookup(8333332) == Grade::Yellow);
+static_assert(DASH_TABLES<60>.up.Lookup(8333333) == Grade::Green);
+static_assert(DASH_TABLES<60>.up.Lookup(16666666) == Grade::Green);
+static_assert(DASH_TABLES<60>.up.Lookup(16666667) == Grade::Yellow);
+static_assert(DASH_TABLES<60>.up.Lookup(21666665) == Grade::Yellow);
+static_assert(DASH_TABLES<60>.up.Lookup(21666666) == Grade::Red);
+
+inline Grade GradeDash(bool isdown, Controller::Clock::duration delta_time) {
+    return DASH_TABLES<60>.Evaluate(isdown, delta_time);
+}
+
+// A graded button: edges of `action` are timed and graded with `tables`.
+struct Technique {
+    std::string name;
+    Controller::Action action;
+    GradeTables tables;
+};
+
+// Refresh rates above this are rejected.
+constexpr unsigned int MAX_RATE = 1000;
+
+struct GradingRules {
+    unsigned int rate = 60;
+    std::vector<Technique> techniques;
+};
+
+GradingRules grading_default_rules(unsigned int rate);
+
+bool parse_grade(const std::string& text, Grade& grade);
+
+// Parses pairs of a grade and the frame count its step starts at, as in
+// the rules below.
+bool parse_grade_steps(const std::vector<std::string>& tokens, std::vector<GradeStep>& steps);
+
+// Rule files hold a refresh rate and one rule per technique and direction:
+// its name and button, then steps of grades and the frame count they start
+// at, the first at 0. A '>' makes a step start just after its frame count.
+//   rate 144
+//   dash Dash down green 0 red 32
+//   dash Dash up red 0 yellow 0.2 green 0.5 yellow >1 red 1.3
+// Techniques without a rule for one direction grade it like a dash does.
+// A rate given here is overridden by a non-zero `rate`. Lines starting with
+// "sequence" are left to sequence_load_rules().
+bool grading_load_rules(const std::string& path, unsigned int rate, GradingRules& rules);
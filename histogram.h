@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Log-bucketed nanosecond histogram: values below 32 ns are exact, every
+// power of two above is split into 32 linear sub-buckets (~3% precision).
+// Recording is allocation-free and meant for a single writer thread; other
+// threads may read it at any time.
+class LatencyHistogram {
+public:
+    void Record(uint64_t value) {
+        auto& bucket = buckets[Index(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > max.load(std::memory_order_relaxed)) {
+            max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename Rep, typename Period>
+    void Record(std::chrono::duration<Rep, Period> duration) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        Record(static_cast<uint64_t>(ns > 0 ? ns : 0));
+    }
+
+    uint64_t Count() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Max() const {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Percentile(double p) const {
+        const auto total = Count();
+        if (total == 0) {
+            return 0;
+        }
+
+        const auto target = static_cast<uint64_t>(p * static_cast<double>(total - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                const auto upper = UpperBound(i);
+                return upper < Max() ? upper : Max();
+            }
+        }
+        return Max();
+    }
+
+    void Print(std::FILE* file, const char* name) const {
+        std::fprintf(file, "%-14s n=%-10llu p50=%9.1fus p99=%9.1fus p99.9=%9.1fus max=%9.1fus\n",
+            name,
+            static_cast<unsigned long long>(Count()),
+            Percentile(0.5) / 1e3, Percentile(0.99) / 1e3, Percentile(0.999) / 1e3,
+            static_cast<double>(Max()) / 1e3);
+    }
+
+private:
+    static constexpr unsigned int SUB_BITS = 5;
+    static constexpr uint64_t SUB_COUNT = 1ull << SUB_BITS;
+
+    static unsigned int HighestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<unsigned int>(__builtin_clzll(value));
+#else
+        unsigned int bit = 0;
+        while (value >>= 1) {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    static size_t Index(uint64_t value) {
+        if (value < SUB_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        const auto bit = HighestBit(value);
+        const auto sub = (value >> (bit - SUB_BITS)) & (SUB_COUNT - 1);
+        return static_cast<size_t>((bit - SUB_BITS + 1) * SUB_COUNT + sub);
+    }
+
+    static uint64_t UpperBound(size_t index) {
+        if (index < SUB_COUNT) {
+            return index;
+        }
+        const auto bit = index / SUB_COUNT + SUB_BITS - 1;
+        const auto sub = index % SUB_COUNT;
+        return ((SUB_COUNT + sub + 1) << (bit - SUB_BITS)) - 1;
+    }
+
+    std::array<std::atomic<uint64_t>, (64 - SUB_BITS + 1) * SUB_COUNT> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> max{0};
+};
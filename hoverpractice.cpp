@@ -1,16 +1,40 @@
 #ifdef _WIN32
 #include <SDKDDKVer.h>
 #include <Windows.h>
+#else
+#include <sys/resource.h>
 #endif
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <variant>
 #include <vector>
 
 #include "controller.h"
+#include "edge_output.h"
+#include "feed.h"
+#include "grading.h"
+#include "binding_cache.h"
+#include "histogram.h"
+#include "live_stats.h"
+#include "recording.h"
+#include "render.h"
+#include "replay.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "sequence.h"
+#include "trace.h"
 
 #ifdef USE_DINPUT
 #include "dinput.h"
@@ -24,6 +48,12 @@
 #else
 #define XINPUT_VARIANT_TYPE
 #endif
+#ifdef USE_EVDEV
+#include "evdev.h"
+#define EVDEV_VARIANT_TYPE std::string,
+#else
+#define EVDEV_VARIANT_TYPE
+#endif
 #include "sdl.h"
 
 #define COLOR_RESET  "\033[0m"
@@ -56,6 +86,8 @@
 
 #define DELETE_LINE   "\033[K"
 
+static const char* const GRADE_COLORS[] = {RED_TEXT, YELLOW_TEXT, GREEN_TEXT};
+
 void ConsoleSetup() {
 #ifdef _WIN32
     BOOL res = 0;
@@ -87,124 +119,331 @@ void ConsoleSetup() {
 
 bool use_dinput = false;
 bool use_xinput = false;
+bool use_evdev = false;
 bool use_sdl = false;
 
+volatile std::sig_atomic_t interrupted = 0;
+
+void on_interrupt(int) {
+    interrupted = 1;
+}
+
+volatile std::sig_atomic_t dump_requested = 0;
+
+void on_dump_request(int) {
+    dump_requested = 1;
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, on_dump_request);
+#endif
+}
+
+// User and system CPU time of the whole process.
+std::chrono::microseconds process_cpu_time() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return {};
+    }
+    const auto ticks = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime)
+        + (static_cast<uint64_t>(user.dwHighDateTime) << 32 | user.dwLowDateTime);
+    return std::chrono::microseconds(ticks / 10);
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+        + std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+#endif
+}
+
 void cleanup() {
 #ifdef USE_DINPUT
     dinput_exit();
 #endif
 #ifdef USE_XINPUT
     xinput_exit();
+#endif
+#ifdef USE_EVDEV
+    evdev_exit();
 #endif
     sdl_exit();
 }
 
-int main()
-{
+using DeviceId = std::variant<DINPUT_VARIANT_TYPE XINPUT_VARIANT_TYPE EVDEV_VARIANT_TYPE int>;
+using DeviceList = std::vector<std::pair<DeviceId, std::string>>;
+
+const char* backend_name(const DeviceId& id) {
 #ifdef USE_DINPUT
-    use_dinput = dinput_init();
-    if (!use_dinput) {
-        std::cout << "DirectInput initialization failed" << std::endl;
+    if (std::holds_alternative<GUID>(id)) {
+        return "DirectInput";
     }
 #endif
-
 #ifdef USE_XINPUT
-    use_xinput = xinput_init();
-    if (!use_xinput) {
-        std::cout << "XInput initialization failed" << std::endl;
+    if (std::holds_alternative<DWORD>(id)) {
+        return "XInput";
     }
 #endif
+#ifdef USE_EVDEV
+    if (std::holds_alternative<std::string>(id)) {
+        return "evdev";
+    }
+#endif
+    return "SDL";
+}
 
-    use_sdl = sdl_init();
-    if (!use_sdl) {
-        std::cout << "SDL initialization failed" << std::endl;
+void print_devices(const DeviceList& devices) {
+    const char* backend = nullptr;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (backend_name(devices[i].first) != backend) {
+            backend = backend_name(devices[i].first);
+            std::cout << backend << " devices:" << std::endl;
+        }
+        std::cout << " [" << std::to_string(i + 1) << "] " << devices[i].second << std::endl;
     }
+}
 
-    ConsoleSetup();
+// Identifies a device across runs for the binding cache.
+std::string device_key(const DeviceId& id) {
+#ifdef USE_DINPUT
+    if (std::holds_alternative<GUID>(id)) {
+        const auto& guid = std::get<GUID>(id);
+        char text[64];
+        std::snprintf(text, sizeof(text), "dinput:%08lx-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+            static_cast<unsigned long>(guid.Data1), guid.Data2, guid.Data3,
+            guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+            guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+        return text;
+    }
+#endif
+#ifdef USE_XINPUT
+    if (std::holds_alternative<DWORD>(id)) {
+        return "xinput:" + std::to_string(std::get<DWORD>(id));
+    }
+#endif
+#ifdef USE_EVDEV
+    if (std::holds_alternative<std::string>(id)) {
+        return "evdev:" + std::get<std::string>(id);
+    }
+#endif
+    const auto index = std::get<int>(id);
+    const auto guid = sdl_guid(index);
+    if (guid.empty()) {
+        return "sdl:" + std::to_string(index);
+    }
+    // Pads of one model share a GUID, so all but the first are numbered in
+    // enumeration order. Pads swapped between ports swap bindings.
+    int same = 0;
+    for (int i = 0; i < index; ++i) {
+        same += sdl_guid(i) == guid ? 1 : 0;
+    }
+    return "sdl:" + guid + (same > 0 ? "#" + std::to_string(same) : "");
+}
 
-    std::cout << "-------------------------------" << std::endl;
+// Initializes and enumerates every backend on its own thread, the slow
+// ones mostly wait on drivers. Devices are listed in backend order.
+//
+// SDL stays on the calling thread: on Windows SDL_Init() creates its
+// device-notification window on the thread it runs on and the window dies
+// with that thread. The sampler polls SDL from its own thread, where those
+// messages never arrive, so the caller has to keep calling sdl_pump() for
+// unplugged devices to come back.
+void init_backends(bool sdl_events, DeviceList& devices) {
+    TraceSpan span("backends");
 
-    std::vector<std::pair<std::variant<DINPUT_VARIANT_TYPE XINPUT_VARIANT_TYPE int>, std::string>> devices;
+    struct Backend {
+        const char* name;
+        bool (*init)(bool sdl_events);
+        void (*enumerate)(DeviceList& devices);
+        bool* enabled;
+        bool on_caller = false;
+        bool ok = false;
+        DeviceList devices;
+    };
 
+    std::vector<Backend> backends;
 #ifdef USE_DINPUT
-    if (use_dinput) {
-        std::cout << "DirectInput devices:" << std::endl;
+    backends.push_back({"DirectInput", [](bool) {
+        TraceSpan span("dinput: init");
+        return dinput_init();
+    }, [](DeviceList& devices) {
+        TraceSpan span("dinput: enum");
         dinput_enum([&](const auto& guidInstance, const auto& name) {
             devices.emplace_back(guidInstance, name);
-            std::cout << " [" << std::to_string(devices.size()) << "] " << name << std::endl;
         });
-    }
+    }, &use_dinput});
 #endif
-
 #ifdef USE_XINPUT
-    if (use_xinput) {
-        std::cout << "XInput devices:" << std::endl;
+    backends.push_back({"XInput", [](bool) {
+        TraceSpan span("xinput: init");
+        return xinput_init();
+    }, [](DeviceList& devices) {
+        TraceSpan span("xinput: enum");
         xinput_enum([&](const auto& dwIndex, const auto& name) {
             devices.emplace_back(dwIndex, name);
-            std::cout << " [" << std::to_string(devices.size()) << "] " << name << std::endl;
         });
-    }
+    }, &use_xinput});
 #endif
-
-    if (use_sdl) {
-        std::cout << "SDL devices:" << std::endl;
+#ifdef USE_EVDEV
+    backends.push_back({"evdev", [](bool) {
+        TraceSpan span("evdev: init");
+        return evdev_init();
+    }, [](DeviceList& devices) {
+        TraceSpan span("evdev: enum");
+        evdev_enum([&](const auto& path, const auto& name) {
+            devices.emplace_back(path, name);
+        });
+    }, &use_evdev});
+#endif
+    backends.push_back({"SDL", [](bool sdl_events) {
+        return sdl_init(sdl_events);
+    }, [](DeviceList& devices) {
+        TraceSpan span("sdl: enum");
         sdl_enum([&](const auto& index, const auto& name) {
             devices.emplace_back(index, name);
-            std::cout << " [" << std::to_string(devices.size()) << "] " << name << std::endl;
         });
-    }
+    }, &use_sdl, true});
 
-    if (devices.empty()) {
-        std::cout << "No device found" << std::endl;
-        cleanup();
-        return 1;
+    const auto& run = [sdl_events](Backend& backend) {
+        backend.ok = backend.init(sdl_events);
+        if (backend.ok) {
+            backend.enumerate(backend.devices);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (auto& backend : backends) {
+        if (!backend.on_caller) {
+            threads.emplace_back(run, std::ref(backend));
+        }
     }
-
-    std::cout << "-------------------------------" << std::endl;
-
-    std::cout << "Enter a number" << std::endl;
-
-    int choice;
-    std::cin >> choice;
-    if (choice < 1 || choice > static_cast<int>(devices.size())) {
-        std::cout << "Invalid choice" << std::endl;
-        cleanup();
-        return 1;
+    for (auto& backend : backends) {
+        if (backend.on_caller) {
+            run(backend);
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
     }
 
-    std::cout << "-------------------------------" << std::endl;
+    for (auto& backend : backends) {
+        *backend.enabled = backend.ok;
+        if (!backend.ok) {
+            std::cout << backend.name << " initialization failed" << std::endl;
+        }
+        devices.insert(devices.end(), backend.devices.begin(), backend.devices.end());
+    }
+}
 
-    auto& device_pair = devices[static_cast<size_t>(choice) - 1];
+Controller* open_device(const std::pair<DeviceId, std::string>& device_pair) {
     Controller* controller = nullptr;
 
-    std::cout << "Opening \"" << device_pair.second << "\" ";
+    std::cout << "Opening \"" << device_pair.second << "\" (" << backend_name(device_pair.first) << ")" << std::endl;
 #ifdef USE_DINPUT
     if (std::holds_alternative<GUID>(device_pair.first)) {
         controller = dinput_open(std::get<GUID>(device_pair.first));
-        std::cout << "(DirectInput)";
     }
 #endif
 #ifdef USE_XINPUT
     if (std::holds_alternative<DWORD>(device_pair.first)) {
         controller = xinput_open(std::get<DWORD>(device_pair.first));
-        std::cout << "(XInput)";
+    }
+#endif
+#ifdef USE_EVDEV
+    if (std::holds_alternative<std::string>(device_pair.first)) {
+        controller = evdev_open(std::get<std::string>(device_pair.first));
     }
 #endif
     if (std::holds_alternative<int>(device_pair.first)) {
         controller = sdl_open(std::get<int>(device_pair.first));
-        std::cout << "(SDL)";
     }
-    std::cout << std::endl;
 
     if (controller == nullptr) {
         std::cout << "Failed" << std::endl;
-        cleanup();
-        return 1;
     }
+    return controller;
+}
 
-    std::cout << "-------------------------------" << std::endl;
+// Opens the device given on the command line, else the last used one if
+// it is still there, else asks; for up to `count` devices when more than
+// one. Returns the device keys in `keys`, nothing when any device failed.
+std::vector<Controller*> open_devices(DeviceList devices, const std::string& evdev_path, const std::string& last, size_t count,
+    std::vector<std::string>& keys) {
+    std::vector<int> choices;
+
+#ifdef USE_EVDEV
+    if (!evdev_path.empty()) {
+        devices.assign(1, {evdev_path, evdev_path});
+        choices.push_back(1);
+    }
+#endif
+
+    if (choices.empty() && count == 1) {
+        for (size_t i = 0; i < devices.size() && !last.empty(); ++i) {
+            if (device_key(devices[i].first) == last) {
+                choices.push_back(static_cast<int>(i) + 1);
+                break;
+            }
+        }
+    }
+
+    if (devices.empty()) {
+        std::cout << "No device found" << std::endl;
+        return {};
+    }
+
+    if (choices.empty()) {
+        print_devices(devices);
+
+        std::cout << "-------------------------------" << std::endl;
+
+        if (count == 1) {
+            std::cout << "Enter a number" << std::endl;
+        } else {
+            std::cout << "Enter up to " << count << " numbers on one line" << std::endl;
+        }
+
+        std::string line;
+        std::getline(std::cin >> std::ws, line);
+        std::stringstream stream(line);
+        int choice;
+        while (choices.size() < count && stream >> choice) {
+            if (choice < 1 || choice > static_cast<int>(devices.size())
+                || std::find(choices.begin(), choices.end(), choice) != choices.end()) {
+                std::cout << "Invalid choice" << std::endl;
+                return {};
+            }
+            choices.push_back(choice);
+        }
+        if (choices.empty()) {
+            std::cout << "Invalid choice" << std::endl;
+            return {};
+        }
+
+        std::cout << "-------------------------------" << std::endl;
+    }
 
+    TraceSpan span("open device");
+    std::vector<Controller*> controllers;
+    for (const auto choice : choices) {
+        const auto& device_pair = devices[static_cast<size_t>(choice) - 1];
+        auto* controller = open_device(device_pair);
+        if (controller == nullptr) {
+            return {};
+        }
+        controllers.push_back(controller);
+        keys.push_back(device_key(device_pair.first));
+    }
+    return controllers;
+}
+
+// Restores the bindings cached for the device unless rebinding, asks for
+// the others and stores them back. Every action in `actions` gets a button.
+void bind_actions(Controller* controller, BindingCache& cache, const std::string& key, bool rebind, Controller::Action actions) {
     const auto& bind_action = [&](const auto& action_str, const auto& action) {
+        int code;
+        if (!rebind && cache.Lookup(key, action, code) && controller->SetBinding(action, code)) {
+            std::cout << action_str << " = cached" << std::endl;
+            return;
+        }
+
         std::cout << "Press " << action_str << " button" << std::endl;
 
         std::string button_name;
@@ -216,73 +455,606 @@ int main()
         while (controller->GetState() & action) {
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+
+        code = controller->GetBinding(action);
+        if (code >= 0) {
+            cache.Store(key, action, code);
+        }
     };
 
-    bind_action("Dash", Controller::Action::Dash);
-    bind_action("Map", Controller::Action::Map);
+    for (unsigned int bit = 0; bit < 8 * sizeof(Controller::Action); ++bit) {
+        const auto action = static_cast<Controller::Action>(1u << bit);
+        const char* name = action_name(action);
+        if ((actions & action) != 0 && name != nullptr) {
+            bind_action(name, action);
+        }
+    }
+}
 
-    std::cout << "-------------------------------" << std::endl;
+// Grades every step of a completed sequence after the first and returns
+// the worst grade among them.
+template <typename Fn>
+static Grade grade_sequence(const SequencePattern& pattern, const Controller::Clock::time_point* times, Fn&& fn) {
+    auto worst = Grade::Green;
+    for (size_t step = 1; step < pattern.steps.size(); ++step) {
+        const auto interval = times[step] - times[step - 1];
+        const auto grade = pattern.tables[step].Lookup(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count());
+        worst = std::min(worst, grade);
+        fn(step, interval, grade);
+    }
+    return worst;
+}
 
-    auto prev_state = controller->GetState();
-    auto button_time = std::chrono::high_resolution_clock::now();
+static void print_sequence_grades(const SequenceRecognizer& sequences, const std::vector<std::array<uint64_t, 3>>& grades,
+    std::FILE* file) {
+    for (size_t i = 0; i < grades.size(); ++i) {
+        std::fprintf(file, "sequence %-10s red=%llu yellow=%llu green=%llu\n", sequences.Patterns()[i].name.c_str(),
+            static_cast<unsigned long long>(grades[i][static_cast<int>(Grade::Red)]),
+            static_cast<unsigned long long>(grades[i][static_cast<int>(Grade::Yellow)]),
+            static_cast<unsigned long long>(grades[i][static_cast<int>(Grade::Green)]));
+    }
+}
 
-    std::string output;
-    unsigned int event_id = 0;
+void run_live(const std::vector<Controller*>& controllers, RecordingWriter& recording, const SchedulerOptions& options,
+    const GradingRules& rules, const SequenceRecognizer& sequences, EdgeOutput& output, FeedPublisher& feed, bool headless,
+    bool trace_startup) {
+    // Records own stdout when they go there, everything for people moves
+    // to stderr.
+    std::FILE* info = output.IsStdout() ? stderr : stdout;
 
-    for (;; std::this_thread::sleep_for(std::chrono::microseconds(500))) {
-        auto state = controller->GetState();
+    for (auto* controller : controllers) {
+        Controller::Edge edge;
+        while (controller->PopEdge(edge)) {
+        }
+    }
 
-        const auto buttons_event = state ^ prev_state;
-        const auto buttons_down = buttons_event & state;
-        const auto buttons_up = buttons_event & prev_state;
+    const auto sampler_start = std::chrono::steady_clock::now();
+    Sampler sampler(controllers, options);
+    trace_record("start sampler", sampler_start, std::chrono::steady_clock::now());
+    if (!sampler.SetupError().empty()) {
+        std::cout << "Scheduler: could not apply " << sampler.SetupError() << std::endl;
+    }
+    if (trace_startup) {
+        trace_print(info);
+        std::fflush(info);
+    }
+
+    // Timing state is kept per device, each gets its own lane.
+    struct Player {
+        Sample last;
+        std::vector<Controller::Clock::time_point> button_times;
+        size_t current = 0;
+        unsigned int event_id = 0;
+        bool attached = true;
+        LiveStats stats;
+        SequenceCursor sequence;
+    };
+
+    const auto start_time = Controller::Clock::now();
+    std::vector<Player> players(controllers.size());
+    for (uint32_t i = 0; i < players.size(); ++i) {
+        players[i].last = {start_time, {}, {}, i};
+        players[i].button_times.assign(rules.techniques.size(), start_time);
+    }
+
+    StatusRenderer renderer(output.IsStdout() ? 2 : 1, controllers.size());
+    uint64_t dropped = 0;
+
+    const auto& banner = [&](uint32_t device, const char* text) {
+        if (headless) {
+            return;
+        }
+        char line[64];
+        if (controllers.size() == 1) {
+            std::snprintf(line, sizeof(line), COLOR_RESET "\n%s\n", text);
+        } else {
+            std::snprintf(line, sizeof(line), COLOR_RESET "\n[%u] %s\n", device + 1, text);
+        }
+        renderer.Banner(line);
+    };
 
-        const bool isdown = (prev_state & Controller::Action::Dash) != 0;
-        const auto current_time = std::chrono::high_resolution_clock::now();
-        const auto delta_time = current_time - button_time;
+    // A lane follows the technique with the device's latest edge.
+    const auto& status = [&](size_t index, const Sample& sample, bool commit) {
+        auto& player = players[sample.device];
+        const auto& technique = rules.techniques[index];
+        const auto prev_state = sample.state ^ sample.edges;
+        const bool isdown = (prev_state & technique.action) != 0;
+        const auto delta_time = sample.time - player.button_times[index];
+
+        const auto grade = technique.tables.Evaluate(isdown, delta_time);
+        if (!headless) {
+            renderer.Status(sample.device, GRADE_COLORS[static_cast<int>(grade)], technique.name.c_str(), player.event_id, isdown,
+                std::chrono::duration_cast<std::chrono::milliseconds>(delta_time).count(), commit);
+        }
+
+        if (commit) {
+            const EdgeRecord record{sample.time, sample.device, player.event_id, technique.name.c_str(), !isdown, delta_time, grade};
+            output.Append(record);
+            if (feed.IsOpen()) {
+                feed.Publish(record);
+            }
+            if ((technique.action & Controller::Action::Dash) != 0) {
+                player.stats.Add(sample.time, !isdown, delta_time, grade);
+            }
+            player.button_times[index] = sample.time;
+            player.event_id = (player.event_id + 1) % 1000;
+            player.current = index;
+        }
+    };
+
+    // A completed sequence gets a line of its own with the interval of
+    // every step, colored by the worst of their grades.
+    std::vector<std::array<uint64_t, 3>> sequence_grades(sequences.Patterns().size());
+    const auto& sequence_done = [&](uint32_t device, size_t index, const Controller::Clock::time_point* times) {
+        auto& player = players[device];
+        const auto& pattern = sequences.Patterns()[index];
+        char text[256];
+        size_t length = 0;
+        const auto append = [&](int written) {
+            if (written > 0) {
+                length = std::min(length + static_cast<size_t>(written), sizeof(text) - 1);
+            }
+        };
+        append(controllers.size() == 1 ? std::snprintf(text, sizeof(text), "%03u %s %s", player.event_id, pattern.name.c_str(),
+            pattern.step_names[0].c_str()) : std::snprintf(text, sizeof(text), "[%u] %03u %s %s", device + 1, player.event_id,
+            pattern.name.c_str(), pattern.step_names[0].c_str()));
+
+        const auto worst = grade_sequence(pattern, times, [&](size_t step, Controller::Clock::duration interval, Grade grade) {
+            append(std::snprintf(text + length, sizeof(text) - length, " %s +%lld ms", pattern.step_names[step].c_str(),
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(interval).count())));
+            const EdgeRecord record{times[step], device, player.event_id, pattern.name.c_str(), true, interval, grade};
+            output.Append(record);
+            if (feed.IsOpen()) {
+                feed.Publish(record);
+            }
+        });
+        ++sequence_grades[index][static_cast<int>(worst)];
+        player.event_id = (player.event_id + 1) % 1000;
+
+        if (!headless) {
+            char line[sizeof(text) + 32];
+            std::snprintf(line, sizeof(line), "%s\n%s\n", GRADE_COLORS[static_cast<int>(worst)], text);
+            renderer.Banner(line);
+        }
+    };
+
+    const auto& update = [&](const Sample& sample) {
+        const auto buttons_down = sample.edges & sample.state;
 
-        output.clear();
         if ((buttons_down & Controller::Action::Map) != 0) {
-            output += COLOR_RESET "\nMAP\n";
+            banner(sample.device, "MAP");
         }
         if ((buttons_down & Controller::Action::Pause) != 0) {
-            output += COLOR_RESET "\nPAUSE\n";
+            banner(sample.device, "PAUSE");
         }
         if ((buttons_down & Controller::Action::Menu) != 0) {
-            output += COLOR_RESET "\nMENU\n";
+            banner(sample.device, "MENU");
+        }
+        if (buttons_down != 0) {
+            sequences.Press(players[sample.device].sequence, static_cast<Controller::Action>(buttons_down), sample.state, sample.time,
+                [&](size_t index, const Controller::Clock::time_point* times) { sequence_done(sample.device, index, times); });
+        }
+
+        bool committed = false;
+        for (size_t i = 0; i < rules.techniques.size(); ++i) {
+            if ((sample.edges & rules.techniques[i].action) != 0) {
+                status(i, sample, true);
+                committed = true;
+            }
+        }
+        if (!committed) {
+            status(players[sample.device].current, sample, false);
+        }
+    };
+
+    LatencyHistogram render_cost;
+    LatencyHistogram display_latency;
+    std::array<Controller::Clock::time_point, 256> pending_edges;
+
+    // CPU use and wakeups are reported since the previous dump.
+    uint64_t render_wakeups = 0;
+    auto power_time = Controller::Clock::now();
+    auto clock_check = power_time;
+    auto sdl_pump_time = power_time;
+    auto power_cpu = process_cpu_time();
+    auto power_wakeups = sampler.Wakeups();
+
+    const auto& stats_name = [&](size_t device) {
+        return players.size() == 1 ? std::string("dash") : "dash [" + std::to_string(device + 1) + "]";
+    };
+
+    // At exit the full stats of every player follow, summaries included.
+    const auto& dump_stats = [&](bool summaries) {
+        const auto now = Controller::Clock::now();
+        const auto cpu = process_cpu_time();
+        const auto wakeups = sampler.Wakeups() + render_wakeups;
+        const auto elapsed = std::chrono::duration<double>(now - power_time).count();
+
+        std::fprintf(info, COLOR_RESET "\n");
+        std::fprintf(info, "%-14s cpu=%5.1f%% wakeups=%8.1f/s%s\n", "power",
+            elapsed > 0 ? std::chrono::duration<double>(cpu - power_cpu).count() * 100.0 / elapsed : 0.0,
+            elapsed > 0 ? static_cast<double>(wakeups - power_wakeups) / elapsed : 0.0,
+            sampler.Idle() ? " (idle)" : "");
+        power_time = now;
+        power_cpu = cpu;
+        power_wakeups = wakeups;
+
+        if (FastClock::UsesTsc()) {
+            std::fprintf(info, "%-14s tsc %.3f GHz, max drift %.1f us\n", "clock", FastClock::Frequency() / 1e9,
+                std::chrono::duration<double, std::micro>(FastClock::MaxDrift()).count());
+        } else {
+            std::fprintf(info, "%-14s steady_clock\n", "clock");
+        }
+        for (size_t i = 0; i < players.size() && summaries; ++i) {
+            players[i].stats.PrintSummary(info, stats_name(i).c_str(), now);
+        }
+        std::fprintf(info, "%-14s %s loop\n", "sampler", sampler.Specialized() ? "specialized" : "virtual");
+        sampler.LoopPeriod().Print(info, "loop period");
+        sampler.WakeLatency().Print(info, "wake latency");
+        sampler.PollCost().Print(info, "poll");
+        render_cost.Print(info, "render");
+        display_latency.Print(info, "edge->display");
+        std::fflush(info);
+    };
+
+    std::signal(SIGINT, on_interrupt);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, on_dump_request);
+#endif
+
+    while (!interrupted) {
+        // While the sampler idles, a frame of display delay goes unnoticed;
+        // without a display only the ring has to be drained in time.
+        std::this_thread::sleep_for(std::chrono::milliseconds(sampler.Idle() || headless ? 16 : 1));
+        ++render_wakeups;
+
+        const auto render_time = Controller::Clock::now();
+        size_t pending = 0;
+
+        Sample sample;
+        while (sampler.Pop(sample)) {
+            recording.Append(sample.time, sample.state, sample.device);
+            update(sample);
+            players[sample.device].last = sample;
+            if (pending < pending_edges.size()) {
+                pending_edges[pending++] = sample.time;
+            }
+        }
+
+        if (sampler.Dropped() != dropped && !headless) {
+            dropped = sampler.Dropped();
+            char text[64];
+            std::snprintf(text, sizeof(text), COLOR_RESET "\nDROPPED %llu SAMPLES\n",
+                static_cast<unsigned long long>(dropped));
+            renderer.Banner(text);
+        }
+
+        const auto now = Controller::Clock::now();
+        if (now - clock_check >= std::chrono::seconds(1)) {
+            FastClock::Check();
+            clock_check = now;
+        }
+        if (now - sdl_pump_time >= std::chrono::milliseconds(100)) {
+            sdl_pump();
+            sdl_pump_time = now;
+        }
+        output.Tick(now);
+        feed.Tick();
+        for (uint32_t i = 0; i < players.size() && !headless; ++i) {
+            // The release of an unplugged device's buttons is a sample like
+            // any other; only the banner tells it apart.
+            if (controllers[i]->Attached() != players[i].attached) {
+                players[i].attached = !players[i].attached;
+                banner(i, players[i].attached ? "RECONNECTED" : "DISCONNECTED");
+            }
+            update({now, players[i].last.state, {}, i});
+        }
+        renderer.Flush();
+
+        const auto display_time = Controller::Clock::now();
+        render_cost.Record(display_time - render_time);
+        for (size_t i = 0; i < pending; ++i) {
+            display_latency.Record(display_time - pending_edges[i]);
+        }
+
+        if (dump_requested) {
+            dump_requested = 0;
+            dump_stats(true);
+        }
+    }
+
+    sampler.Stop();
+    output.Flush();
+    std::cout << COLOR_RESET "\n-------------------------------" << std::endl;
+    std::cout << "Sampler: " << sampler.Dropped() << " dropped, " << sampler.Misses() << " missed deadlines" << std::endl;
+    dump_stats(false);
+    std::fprintf(info, "\n");
+    for (size_t i = 0; i < players.size(); ++i) {
+        players[i].stats.Print(info, stats_name(i).c_str(), Controller::Clock::now());
+    }
+    print_sequence_grades(sequences, sequence_grades, info);
+}
+
+void run_fast_replay(ReplayController& replay, const GradingRules& rules, const SequenceRecognizer& sequences, EdgeOutput& output,
+    FeedPublisher& feed) {
+    uint64_t grades[3]{};
+    LiveStats stats;
+    SequenceCursor sequence;
+    std::vector<std::array<uint64_t, 3>> sequence_grades(sequences.Patterns().size());
+    Controller::Clock::time_point last_time{};
+    unsigned int event_id = 0;
+    Controller::Action prev_state{};
+    std::vector<Controller::Clock::time_point> button_times(rules.techniques.size());
+
+    const auto start = std::chrono::steady_clock::now();
+
+    replay.GetState();
+    Controller::Edge edge;
+    while (replay.PopEdge(edge)) {
+        const auto edges = edge.state ^ prev_state;
+        for (size_t i = 0; i < rules.techniques.size(); ++i) {
+            const auto& technique = rules.techniques[i];
+            if ((edges & technique.action) != 0) {
+                const bool isdown = (prev_state & technique.action) != 0;
+                const auto grade = technique.tables.Evaluate(isdown, edge.time - button_times[i]);
+                ++grades[static_cast<int>(grade)];
+                const EdgeRecord record{edge.time, 0, event_id, technique.name.c_str(), !isdown, edge.time - button_times[i], grade};
+                output.Append(record);
+                if (feed.IsOpen()) {
+                    feed.Publish(record);
+                }
+                if ((technique.action & Controller::Action::Dash) != 0) {
+                    stats.Add(edge.time, !isdown, edge.time - button_times[i], grade);
+                }
+                button_times[i] = edge.time;
+                event_id = (event_id + 1) % 1000;
+            }
+        }
+        const auto pressed = static_cast<Controller::Action>(edges & edge.state);
+        if (pressed != 0) {
+            sequences.Press(sequence, pressed, edge.state, edge.time, [&](size_t index, const Controller::Clock::time_point* times) {
+                const auto& pattern = sequences.Patterns()[index];
+                const auto worst = grade_sequence(pattern, times, [&](size_t step, Controller::Clock::duration interval, Grade grade) {
+                    const EdgeRecord record{times[step], 0, event_id, pattern.name.c_str(), true, interval, grade};
+                    output.Append(record);
+                    if (feed.IsOpen()) {
+                        feed.Publish(record);
+                    }
+                });
+                ++sequence_grades[index][static_cast<int>(worst)];
+                event_id = (event_id + 1) % 1000;
+            });
         }
+        prev_state = edge.state;
+        last_time = edge.time;
+    }
+    output.Flush();
 
-        static constexpr auto frame_duration =
-            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::seconds(1)) / 60;
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << replay.Size() << " edges in " << elapsed * 1000.0 << " ms ("
+        << (elapsed > 0 ? replay.Size() / elapsed : 0.0) << " edges/s)" << std::endl;
+    std::cout << "Red: " << grades[static_cast<int>(Grade::Red)]
+        << " Yellow: " << grades[static_cast<int>(Grade::Yellow)]
+        << " Green: " << grades[static_cast<int>(Grade::Green)] << std::endl;
+    // Replayed edges are timed from the clock's epoch, so the time window
+    // ends at the last of them.
+    std::cout.flush();
+    stats.Print(output.IsStdout() ? stderr : stdout, "dash", last_time);
+    print_sequence_grades(sequences, sequence_grades, output.IsStdout() ? stderr : stdout);
+}
 
-        if (isdown) {
-            output += (delta_time < frame_duration * 32) ? GREEN_TEXT : RED_TEXT;
+int main(int argc, char* argv[])
+{
+    bool sdl_events = false;
+    std::string evdev_path;
+    std::string record_path;
+    std::string replay_path;
+    bool replay_fast = false;
+    SchedulerOptions scheduler;
+    std::string rules_path;
+    unsigned int rate = 0;
+    std::string cache_path = BindingCache::DefaultPath();
+    bool rebind = false;
+    bool trace_startup = false;
+    size_t players = 1;
+    Controller::AxisThreshold axis_threshold;
+    std::string output_path;
+    OutputFormat output_format = OutputFormat::JsonLines;
+    bool headless = false;
+    std::string feed_name;
+    bool use_tsc = true;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--sdl-events") == 0) {
+            sdl_events = true;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--fast") == 0) {
+            replay_fast = true;
+        } else if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            scheduler.period = std::chrono::microseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--spin") == 0 && i + 1 < argc) {
+            scheduler.spin = std::chrono::microseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--rt") == 0 && i + 1 < argc) {
+            scheduler.priority = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            scheduler.cpu = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--mlock") == 0) {
+            scheduler.lock_memory = true;
+        } else if (std::strcmp(argv[i], "--idle") == 0 && i + 1 < argc) {
+            scheduler.idle_after = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--rebind") == 0) {
+            rebind = true;
+        } else if (std::strcmp(argv[i], "--players") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            players = std::min(static_cast<size_t>(std::atoi(argv[++i])), StatusRenderer::MAX_LANES);
+        } else if (std::strcmp(argv[i], "--axis-press") == 0 && i + 1 < argc) {
+            axis_threshold.press = std::clamp(std::atoi(argv[++i]), 1, 100) * 32767 / 100;
+        } else if (std::strcmp(argv[i], "--axis-release") == 0 && i + 1 < argc) {
+            axis_threshold.release = std::clamp(std::atoi(argv[++i]), 0, 100) * 32767 / 100;
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc
+            && (std::strcmp(argv[i + 1], "jsonl") == 0 || std::strcmp(argv[i + 1], "csv") == 0)) {
+            output_format = std::strcmp(argv[++i], "csv") == 0 ? OutputFormat::Csv : OutputFormat::JsonLines;
+        } else if (std::strcmp(argv[i], "--feed") == 0) {
+            feed_name = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "hoverpractice";
+        } else if (std::strcmp(argv[i], "--no-tsc") == 0) {
+            use_tsc = false;
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (std::strcmp(argv[i], "--trace-startup") == 0) {
+            trace_startup = true;
+        } else if (std::strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            rules_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0
+                   && std::atoi(argv[i + 1]) <= static_cast<int>(MAX_RATE)) {
+            rate = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--idle-period") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            scheduler.idle_period = std::chrono::microseconds(std::atoi(argv[++i]));
+#ifdef USE_EVDEV
+        } else if (std::strcmp(argv[i], "--evdev") == 0 && i + 1 < argc) {
+            evdev_path = argv[++i];
+#endif
         } else {
-            if (delta_time >= frame_duration * 1.3f || delta_time < frame_duration * 0.2f) output += RED_TEXT;
-            else if (delta_time < frame_duration * 0.5f || delta_time > frame_duration) output += YELLOW_TEXT;
-            else output += GREEN_TEXT;
+            std::cout << "Usage: " << argv[0] << " [--sdl-events] [--record <file>] [--replay <recording or script> [--fast]]"
+#ifdef USE_EVDEV
+                " [--evdev <device or recorded stream>]"
+#endif
+                " [--period <us>] [--spin <us>] [--rt <priority>] [--cpu <n>] [--mlock]"
+                " [--idle <ms>] [--idle-period <us>] [--rules <file>] [--rate <hz>]"
+                " [--cache <file>] [--rebind] [--players <n>] [--axis-press <%>] [--axis-release <%>]"
+                " [--output <file or ->] [--format jsonl|csv] [--feed [name]] [--no-tsc] [--headless] [--trace-startup]"
+                << std::endl;
+            return 1;
+        }
+    }
+
+    // Before anything takes a timestamp that is kept.
+    if (use_tsc) {
+        FastClock::Calibrate();
+    }
+
+    EdgeOutput output;
+    if (!output_path.empty()) {
+        if (!output.Open(output_path, output_format, Controller::Clock::now())) {
+            std::cout << "Cannot write output \"" << output_path << "\"" << std::endl;
+            return 1;
+        }
+        // Keep stdout to the records alone.
+        if (output.IsStdout()) {
+            std::cout.rdbuf(std::cerr.rdbuf());
+        }
+    }
+
+    FeedPublisher feed;
+    if (!feed_name.empty()) {
+        if (!feed.Open(feed_name, Controller::Clock::now())) {
+            std::cout << "Cannot publish feed \"" << feed_name << "\": " << feed.Error() << std::endl;
+            return 1;
+        }
+        std::cout << "Publishing feed \"" << feed_name << "\""
+            << (feed.UsesSocket() ? " on " + feed_socket_path(feed_name) : std::string(" in shared memory")) << std::endl;
+    }
+
+    GradingRules rules = grading_default_rules(rate != 0 ? rate : 60);
+    if (!rules_path.empty() && !grading_load_rules(rules_path, rate, rules)) {
+        std::cout << "Cannot read grading rules \"" << rules_path << "\"" << std::endl;
+        return 1;
+    }
+    SequenceRecognizer sequences;
+    if (!rules_path.empty() && !sequence_load_rules(rules_path, rules.rate, sequences)) {
+        std::cout << "Cannot read sequences in \"" << rules_path << "\"" << std::endl;
+        return 1;
+    }
+
+    DeviceList devices;
+    if (replay_path.empty()) {
+        init_backends(sdl_events, devices);
+    }
+
+    ConsoleSetup();
+
+    std::cout << "-------------------------------" << std::endl;
+
+    std::unique_ptr<ReplayController> replay;
+    std::vector<Controller*> controllers;
+
+    if (!replay_path.empty()) {
+        std::vector<Controller::Edge> edges;
+        if (!replay_load_recording(replay_path, 0, edges) && !replay_load_script(replay_path, edges)) {
+            std::cout << "Cannot read replay \"" << replay_path << "\"" << std::endl;
+            return 1;
         }
 
-        char event_id_buf[10];
-        snprintf(event_id_buf, sizeof(event_id_buf), "%03u", event_id);
+        replay = std::make_unique<ReplayController>(std::move(edges), !replay_fast);
+        std::cout << "Replaying \"" << replay_path << "\" (" << replay->Size() << " edges)" << std::endl;
 
-        output += "\r";
-        output += std::string(event_id_buf) + " dash button " + (isdown ? "down" : "up");
-        output += " (" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(delta_time).count()) + " ms)";
+        if (replay_fast) {
+            run_fast_replay(*replay, rules, sequences, output, feed);
+            return 0;
+        }
+        controllers.push_back(replay.get());
+    } else {
+        BindingCache cache;
+        if (!cache_path.empty()) {
+            cache.Load(cache_path);
+        }
 
-        output = output.substr(0, 64);
-        output.resize(64, ' ');
+        // Dash and Map always, plus whatever the rules grade or recognize.
+        auto actions = static_cast<Controller::Action>(Controller::Action::Dash | Controller::Action::Map);
+        for (const auto& technique : rules.techniques) {
+            actions = static_cast<Controller::Action>(actions | technique.action);
+        }
+        for (const auto& pattern : sequences.Patterns()) {
+            for (const auto step : pattern.steps) {
+                actions = static_cast<Controller::Action>(actions | step);
+            }
+        }
 
-        if (buttons_event & Controller::Action::Dash) {
-            output += "\n";
-            button_time = current_time;
-            event_id = (event_id + 1) % 1000;
+        std::vector<std::string> keys;
+        controllers = open_devices(devices, evdev_path, rebind ? std::string() : cache.Last(), players, keys);
+        if (controllers.empty()) {
+            cleanup();
+            return 1;
         }
-        std::cout << output;
 
-        prev_state = state;
+        {
+            TraceSpan span("bind actions");
+            for (size_t i = 0; i < controllers.size(); ++i) {
+                std::cout << "-------------------------------" << std::endl;
+                if (controllers.size() > 1) {
+                    std::cout << "Player " << i + 1 << std::endl;
+                }
+                controllers[i]->SetAxisThreshold(axis_threshold);
+                bind_actions(controllers[i], cache, keys[i], rebind, actions);
+            }
+        }
+        if (controllers.size() == 1) {
+            cache.SetLast(keys[0]);
+        }
+        if (!cache_path.empty() && !cache.Save(cache_path)) {
+            std::cout << "Cannot write binding cache \"" << cache_path << "\"" << std::endl;
+        }
     }
 
+    std::cout << "-------------------------------" << std::endl;
+
+    RecordingWriter recording;
+    if (!record_path.empty()) {
+        if (!recording.Open(record_path, Controller::Clock::now())) {
+            std::cout << "Cannot write recording \"" << record_path << "\"" << std::endl;
+            cleanup();
+            return 1;
+        }
+        std::cout << "Recording to \"" << record_path << "\"" << std::endl;
+    }
+
+    run_live(controllers, recording, scheduler, rules, sequences, output, feed, headless, trace_startup);
+    recording.Close();
+
     cleanup();
     return 0;
 }
-
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "controller.h"
+#include "grading.h"
+
+// Running statistics over one player's graded Dash edges: per-grade counts,
+// the mean and deviation of hover and gap times, green streaks and the
+// green rate overall, over the last LAST_EDGES edges and over the last
+// LAST_SECONDS seconds. Add() is constant-time and never allocates, the
+// windows live in fixed rings.
+class LiveStats {
+public:
+    static constexpr size_t LAST_EDGES = 50;
+    static constexpr size_t LAST_SECONDS = 60;
+
+    // Welford's online mean and variance, in milliseconds.
+    struct Moments {
+        uint64_t count = 0;
+        double mean = 0.0;
+        double m2 = 0.0;
+
+        void Add(double value) {
+            ++count;
+            const auto delta = value - mean;
+            mean += delta / static_cast<double>(count);
+            m2 += delta * (value - mean);
+        }
+
+        double Deviation() const {
+            return count > 1 ? std::sqrt(m2 / static_cast<double>(count - 1)) : 0.0;
+        }
+    };
+
+    // A press ends a gap between hovers, a release ends a hover.
+    void Add(Controller::Clock::time_point time, bool press, Controller::Clock::duration interval, Grade grade) {
+        const bool green = grade == Grade::Green;
+        ++edges;
+        ++grades[static_cast<int>(grade)];
+        (press ? gaps : hovers).Add(std::chrono::duration<double, std::milli>(interval).count());
+
+        streak = green ? streak + 1 : 0;
+        if (streak > best_streak) {
+            best_streak = streak;
+        }
+
+        auto& last = last_edges[recent_index];
+        if (edges > LAST_EDGES) {
+            recent_green -= last;
+        }
+        last = green ? 1 : 0;
+        recent_green += last;
+        recent_index = (recent_index + 1) % LAST_EDGES;
+
+        const auto second = Second(time);
+        auto& bucket = seconds[static_cast<size_t>(second) % LAST_SECONDS];
+        if (bucket.second != second) {
+            bucket = {second, 0, 0};
+        }
+        ++bucket.edges;
+        bucket.green += green ? 1 : 0;
+    }
+
+    uint64_t Edges() const {
+        return edges;
+    }
+
+    uint64_t Count(Grade grade) const {
+        return grades[static_cast<int>(grade)];
+    }
+
+    double GreenRate() const {
+        return Rate(Count(Grade::Green), edges);
+    }
+
+    double RecentGreenRate() const {
+        return Rate(recent_green, edges < LAST_EDGES ? edges : LAST_EDGES);
+    }
+
+    // Walks the ring of seconds, so it is for display rather than for
+    // every edge.
+    double WindowGreenRate(Controller::Clock::time_point now) const {
+        const auto second = Second(now);
+        uint64_t total = 0;
+        uint64_t green = 0;
+        for (const auto& bucket : seconds) {
+            if (bucket.edges != 0 && bucket.second > second - static_cast<int64_t>(LAST_SECONDS) && bucket.second <= second) {
+                total += bucket.edges;
+                green += bucket.green;
+            }
+        }
+        return Rate(green, total);
+    }
+
+    uint32_t Streak() const {
+        return streak;
+    }
+
+    uint32_t BestStreak() const {
+        return best_streak;
+    }
+
+    const Moments& Hovers() const {
+        return hovers;
+    }
+
+    const Moments& Gaps() const {
+        return gaps;
+    }
+
+    void PrintSummary(std::FILE* file, const char* name, Controller::Clock::time_point now) const {
+        std::fprintf(file, "%-14s n=%-6llu green=%5.1f%% last%zu=%5.1f%% last%zus=%5.1f%% streak=%u best=%u hover=%.1f+-%.1fms\n",
+            name, static_cast<unsigned long long>(edges), GreenRate(),
+            LAST_EDGES, RecentGreenRate(), LAST_SECONDS, WindowGreenRate(now),
+            streak, best_streak, hovers.mean, hovers.Deviation());
+    }
+
+    void Print(std::FILE* file, const char* name, Controller::Clock::time_point now) const {
+        PrintSummary(file, name, now);
+        std::fprintf(file, "  grades       red=%llu yellow=%llu green=%llu\n",
+            static_cast<unsigned long long>(Count(Grade::Red)),
+            static_cast<unsigned long long>(Count(Grade::Yellow)),
+            static_cast<unsigned long long>(Count(Grade::Green)));
+        std::fprintf(file, "  hover        n=%llu mean=%.3fms sd=%.3fms\n",
+            static_cast<unsigned long long>(hovers.count), hovers.mean, hovers.Deviation());
+        std::fprintf(file, "  gap          n=%llu mean=%.3fms sd=%.3fms\n",
+            static_cast<unsigned long long>(gaps.count), gaps.mean, gaps.Deviation());
+    }
+
+private:
+    struct Bucket {
+        int64_t second;
+        uint32_t edges;
+        uint32_t green;
+    };
+
+    static int64_t Second(Controller::Clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    }
+
+    static double Rate(uint64_t part, uint64_t total) {
+        return total != 0 ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+    }
+
+    uint64_t edges = 0;
+    std::array<uint64_t, 3> grades{};
+    Moments hovers;
+    Moments gaps;
+
+    uint32_t streak = 0;
+    uint32_t best_streak = 0;
+
+    std::array<uint8_t, LAST_EDGES> last_edges{};
+    size_t recent_index = 0;
+    uint32_t recent_green = 0;
+
+    std::array<Bucket, LAST_SECONDS> seconds{};
+};
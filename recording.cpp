@@ -0,0 +1,75 @@
+#include <cstring>
+
+#include "recording.h"
+
+bool ReadRecordingHeader(const void* data, size_t size, RecordingHeader& header) {
+    if (size < sizeof(header)) {
+        return false;
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+    return std::memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) == 0
+        && header.version == RECORDING_VERSION
+        && header.record_size == sizeof(uint32_t)
+        && header.tick_ns != 0;
+}
+
+RecordingWriter::~RecordingWriter() {
+    Close();
+}
+
+bool RecordingWriter::Open(const std::string& path, const Controller::Clock::time_point& start) {
+    Close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    RecordingHeader header{};
+    std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.record_size = sizeof(uint32_t);
+    header.tick_ns = RECORDING_TICK_NS;
+    header.start_unix_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        Close();
+        return false;
+    }
+
+    last_time = start;
+    return true;
+}
+
+void RecordingWriter::Append(const Controller::Clock::time_point& time, Controller::Action state, uint32_t device) {
+    if (file == nullptr) {
+        return;
+    }
+
+    const auto ticks = std::chrono::duration_cast<std::chrono::nanoseconds>(time - last_time).count() / RECORDING_TICK_NS;
+    auto delta = ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+    last_time += std::chrono::nanoseconds(delta * RECORDING_TICK_NS);
+
+    for (; delta > RECORD_DELTA_MAX; delta -= RECORD_DELTA_MAX) {
+        Push(EncodeRecord(RECORD_DELTA_MAX, 0, RECORD_DEVICE_TICK));
+    }
+    Push(EncodeRecord(static_cast<uint32_t>(delta), state, device));
+}
+
+void RecordingWriter::Flush() {
+    if (file != nullptr && size > 0) {
+        std::fwrite(buffer.data(), sizeof(buffer[0]), size, file);
+    }
+    size = 0;
+}
+
+void RecordingWriter::Close() {
+    if (file != nullptr) {
+        Flush();
+        std::fclose(file);
+        file = nullptr;
+    }
+}
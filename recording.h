@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "controller.h"
+
+// Session recordings are a fixed header followed by fixed-width 32-bit
+// little-endian records, so a file can be mapped and scanned in place:
+//
+//   bits  0-5   Controller::Action mask after the edge
+//   bits  6-11  device id, RECORD_DEVICE_TICK marks a pure time advance
+//   bits 12-31  time since the previous record, in units of tick_ns
+//
+// Gaps longer than RECORD_DELTA_MAX ticks are split with tick records.
+struct RecordingHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t tick_ns;
+    uint32_t flags;
+    uint64_t start_unix_ns;
+    uint64_t reserved;
+};
+static_assert(sizeof(RecordingHeader) == 32, "RecordingHeader must stay 32 bytes");
+
+constexpr char RECORDING_MAGIC[4] = {'H', 'P', 'R', 'C'};
+constexpr uint16_t RECORDING_VERSION = 1;
+constexpr uint32_t RECORDING_TICK_NS = 1000;
+
+constexpr uint32_t RECORD_DEVICE_TICK = 63;
+constexpr uint32_t RECORD_DELTA_MAX = (1u << 20) - 1;
+
+constexpr uint32_t EncodeRecord(uint32_t delta, uint32_t state, uint32_t device) {
+    return (delta << 12) | ((device & 0x3f) << 6) | (state & 0x3f);
+}
+
+constexpr Controller::Action RecordState(uint32_t record) {
+    return static_cast<Controller::Action>(record & 0x3f);
+}
+
+constexpr uint32_t RecordDevice(uint32_t record) {
+    return (record >> 6) & 0x3f;
+}
+
+constexpr uint32_t RecordDelta(uint32_t record) {
+    return record >> 12;
+}
+
+bool ReadRecordingHeader(const void* data, size_t size, RecordingHeader& header);
+
+// Collects records in a fixed buffer and writes them out in large batches.
+class RecordingWriter {
+public:
+    RecordingWriter() = default;
+    ~RecordingWriter();
+
+    bool Open(const std::string& path, const Controller::Clock::time_point& start);
+    void Append(const Controller::Clock::time_point& time, Controller::Action state, uint32_t device);
+    void Flush();
+    void Close();
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+private:
+    void Push(uint32_t record) {
+        if (size == buffer.size()) {
+            Flush();
+        }
+        buffer[size++] = record;
+    }
+
+    std::FILE* file = nullptr;
+    std::array<uint32_t, 16384> buffer;
+    size_t size = 0;
+    Controller::Clock::time_point last_time;
+};
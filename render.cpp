@@ -0,0 +1,89 @@
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+#include "render.h"
+
+void StatusRenderer::Write(int fd, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        const auto written = _write(fd, data, static_cast<unsigned int>(size));
+#else
+        const auto written = write(fd, data, size);
+#endif
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+void StatusRenderer::Banner(const char* text) {
+    const auto length = std::strlen(text);
+    if (size + length > sizeof(buffer)) {
+        Flush();
+    }
+    std::memcpy(buffer + size, text, length);
+    size += length;
+    redraw = true;
+}
+
+void StatusRenderer::Status(size_t lane, const char* color, const char* name, unsigned int event_id, bool isdown, long long ms,
+    bool commit) {
+    auto& state = lane_state[lane < lanes ? lane : lanes - 1];
+    if (!commit && !redraw && color == state.color && name == state.name && event_id == state.event_id
+        && isdown == state.isdown && ms == state.ms) {
+        return;
+    }
+
+    state.color = color;
+    state.name = name;
+    state.event_id = event_id;
+    state.isdown = isdown;
+    state.ms = ms;
+    redraw = false;
+
+    if (size + LINE_MAX > sizeof(buffer)) {
+        Flush();
+    }
+
+    if (lanes == 1) {
+        // The color sequence and carriage return count towards the line width.
+        const int text_width = static_cast<int>(LINE_WIDTH - std::strlen(color) - 1);
+        std::snprintf(state.text, sizeof(state.text), "%03u %s button %s (%lld ms)", event_id, name, isdown ? "down" : "up", ms);
+        const auto length = std::snprintf(buffer + size, sizeof(buffer) - size, "%s\r%-*.*s%s",
+            color, text_width, text_width, state.text, commit ? "\n" : "");
+        if (length > 0) {
+            size += static_cast<size_t>(length);
+        }
+        return;
+    }
+
+    // Every lane is redrawn, so a committed line keeps what the other
+    // devices showed at the time.
+    std::snprintf(state.text, sizeof(state.text), "[%zu] %03u %s button %s (%lld ms)",
+        lane + 1, event_id, name, isdown ? "down" : "up", ms);
+    buffer[size++] = '\r';
+    for (size_t i = 0; i < lanes; ++i) {
+        const auto length = std::snprintf(buffer + size, sizeof(buffer) - size, "%s%-*.*s",
+            lane_state[i].color != nullptr ? lane_state[i].color : "\033[0m",
+            static_cast<int>(LANE_WIDTH), static_cast<int>(LANE_WIDTH), lane_state[i].text);
+        if (length > 0) {
+            size += static_cast<size_t>(length);
+        }
+    }
+    if (commit) {
+        buffer[size++] = '\n';
+    }
+}
+
+void StatusRenderer::Flush() {
+    Write(fd, buffer, size);
+    size = 0;
+}
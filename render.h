@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+// Formats the live status line into a fixed buffer and writes it out only
+// when something visible changed, with a single write() per Flush(). With
+// more than one lane the line is split into a column per device.
+class StatusRenderer {
+public:
+    static constexpr size_t MAX_LANES = 4;
+
+    explicit StatusRenderer(int fd = 1, size_t lanes = 1) : fd(fd), lanes(lanes < 1 ? 1 : lanes > MAX_LANES ? MAX_LANES : lanes) {}
+
+    void Banner(const char* text);
+    void Status(size_t lane, const char* color, const char* name, unsigned int event_id, bool isdown, long long ms, bool commit);
+    void Flush();
+
+    static void Write(int fd, const char* data, size_t size);
+
+private:
+    static constexpr size_t LINE_WIDTH = 64;
+    static constexpr size_t LANE_WIDTH = 38;
+    // Longest line: every lane with its color sequence, plus "\r" and "\n".
+    static constexpr size_t LINE_MAX = MAX_LANES * (LANE_WIDTH + 16) + 2;
+
+    struct Lane {
+        const char* color = nullptr;
+        const char* name = nullptr;
+        unsigned int event_id = 0;
+        bool isdown = false;
+        long long ms = -1;
+        char text[LANE_WIDTH + 1]{};
+    };
+
+    int fd;
+    size_t lanes;
+    char buffer[4096];
+    size_t size = 0;
+
+    Lane lane_state[MAX_LANES];
+    bool redraw = true;
+};
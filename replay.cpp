@@ -0,0 +1,142 @@
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "recording.h"
+#include "replay.h"
+#include "sampler.h"
+
+bool replay_load_recording(const std::string& path, uint32_t device, std::vector<Controller::Edge>& edges) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    RecordingHeader header;
+    if (!ReadRecordingHeader(data.data(), data.size(), header)) {
+        return false;
+    }
+
+    const auto count = (data.size() - sizeof(header)) / sizeof(uint32_t);
+    auto records = reinterpret_cast<const uint32_t*>(data.data() + sizeof(header));
+
+    Controller::Clock::time_point time{};
+    for (size_t i = 0; i < count; ++i) {
+        time += std::chrono::nanoseconds(static_cast<uint64_t>(RecordDelta(records[i])) * header.tick_ns);
+        if (RecordDevice(records[i]) == device) {
+            edges.push_back({time, RecordState(records[i])});
+        }
+    }
+
+    return true;
+}
+
+static const std::pair<const char*, Controller::Action> ACTION_NAMES[] = {
+    {"Dash", Controller::Action::Dash},
+    {"Slash", Controller::Action::Slash},
+    {"Item", Controller::Action::Item},
+    {"Map", Controller::Action::Map},
+    {"Menu", Controller::Action::Menu},
+    {"Pause", Controller::Action::Pause}
+};
+
+const char* action_name(Controller::Action action) {
+    for (const auto& pair : ACTION_NAMES) {
+        if (action == pair.second) {
+            return pair.first;
+        }
+    }
+    return nullptr;
+}
+
+bool parse_actions(const std::string& text, Controller::Action& state) {
+    state = {};
+    if (text == "-") {
+        return true;
+    }
+
+    std::stringstream stream(text);
+    std::string name;
+    while (std::getline(stream, name, '+')) {
+        bool found = false;
+        for (const auto& pair : ACTION_NAMES) {
+            if (name == pair.first) {
+                state = static_cast<Controller::Action>(state | pair.second);
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool replay_load_script(const std::string& path, std::vector<Controller::Edge>& edges) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    Controller::Clock::time_point time{};
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream stream(line);
+        double delay_ms;
+        std::string actions;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        Controller::Action state;
+        if (!(stream >> delay_ms >> actions) || delay_ms < 0 || !parse_actions(actions, state)) {
+            return false;
+        }
+
+        time += std::chrono::duration_cast<Controller::Clock::duration>(
+            std::chrono::duration<double, std::milli>(delay_ms));
+        edges.push_back({time, state});
+    }
+
+    return true;
+}
+
+ReplayController::ReplayController(std::vector<Edge> edges, bool realtime)
+    : Controller(), edges(std::move(edges)), realtime(realtime) {
+    offset = realtime ? Clock::now().time_since_epoch() : Clock::duration{};
+}
+
+std::string ReplayController::BindAction(Action action) {
+    return "Recorded";
+}
+
+Controller::Action ReplayController::GetState() {
+    if (!realtime) {
+        released = edges.size();
+    } else {
+        const auto now = Clock::now() - offset;
+        while (released < edges.size() && edges[released].time <= now) {
+            ++released;
+        }
+    }
+
+    if (released != 0) {
+        state = edges[released - 1].state;
+    }
+    return state;
+}
+
+bool ReplayController::PopEdge(Edge& edge) {
+    if (next == released) {
+        return false;
+    }
+
+    edge = edges[next++];
+    edge.time += offset;
+    return true;
+}
+
+Controller::SampleLoop ReplayController::Loop() const {
+    return &Sampler::Loop<ReplayController>;
+}
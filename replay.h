@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "controller.h"
+
+// Edges loaded for replay are timed relative to Controller::Clock's epoch.
+bool replay_load_recording(const std::string& path, uint32_t device, std::vector<Controller::Edge>& edges);
+
+// Parses action names joined by '+', e.g. "Dash+Map", or "-" for none.
+bool parse_actions(const std::string& text, Controller::Action& state);
+
+// Name of a single action, nullptr for anything else.
+const char* action_name(Controller::Action action);
+
+// Scripts hold one edge per line: the delay in milliseconds since the
+// previous line followed by the actions held afterwards, e.g.
+//   16.7 Dash+Map
+//   4 -
+bool replay_load_script(const std::string& path, std::vector<Controller::Edge>& edges);
+
+// Plays a prepared edge stream back against a virtual clock. In real time
+// the stream starts when the controller is created, otherwise every edge is
+// available at once with its recorded spacing.
+class ReplayController final : public Controller {
+public:
+    ReplayController(std::vector<Edge> edges, bool realtime);
+
+    std::string BindAction(Action action) override;
+    Action GetState() override;
+    bool PopEdge(Edge& edge) override;
+    SampleLoop Loop() const override;
+
+    bool Finished() const {
+        return next == edges.size();
+    }
+
+    size_t Size() const {
+        return edges.size();
+    }
+
+private:
+    std::vector<Edge> edges;
+    size_t next = 0;
+    size_t released = 0;
+    Clock::duration offset;
+    bool realtime;
+    Action state{};
+};
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <future>
+
+#include "sampler.h"
+
+Sampler::Sampler(const std::vector<Controller*>& controllers, const SchedulerOptions& options, bool specialize)
+    : controllers(controllers), loop(nullptr), options(options), scheduler(options) {
+    for (auto* controller : controllers) {
+        prev_states.push_back(controller->GetState());
+
+        // A lone controller is cheaper to poll directly.
+        const auto group = controllers.size() > 1 ? controller->PollGroup() : nullptr;
+        if (group != nullptr && std::find(groups.begin(), groups.end(), group) == groups.end()) {
+            groups.push_back(group);
+        }
+        grouped.push_back(group != nullptr);
+
+        if (controller == controllers.front()) {
+            loop = specialize ? controller->Loop() : nullptr;
+        } else if (controller->Loop() != loop) {
+            loop = nullptr;
+        }
+    }
+    if (loop == nullptr) {
+        loop = &Loop<Controller>;
+    }
+
+    std::promise<void> configured;
+    auto ready = configured.get_future();
+    thread = std::thread([this, &configured] {
+        setup_error = scheduler.Configure();
+        configured.set_value();
+        loop(*this);
+    });
+    ready.wait();
+}
+
+Sampler::~Sampler() {
+    Stop();
+}
+
+void Sampler::Stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "controller.h"
+#include "histogram.h"
+#include "scheduler.h"
+#include "spsc_ring.h"
+
+struct Sample {
+    Controller::Clock::time_point time;
+    Controller::Action state;
+    Controller::Action edges;
+    // Index into the sampled controllers.
+    uint32_t device;
+};
+
+// Owns the controllers while running: GetState() is only ever called from
+// the sampler thread, which publishes every edge to the ring. Polled edges
+// are stamped with the scheduler deadline they were sampled at, the same
+// for every controller however many there are.
+//
+// After a while without input the sampler idles: it blocks on backends that
+// wake up on input, whose edges carry their own event time, and polls other
+// backends at the idle period. A polled first edge after that is late by up
+// to the idle period, but it starts a press, and presses are only graded
+// against a 32 frame limit. Only a lone controller is waited on, several
+// are polled at the idle period.
+//
+// The loop is a template over the controllers' concrete type, instantiated
+// by each backend and chosen once at startup; mixed backends run it over
+// Controller, a virtual call per read.
+class Sampler {
+public:
+    // Returns once the sampler thread has applied the scheduler options.
+    // Without `specialize` the generic loop runs whatever the backend.
+    Sampler(const std::vector<Controller*>& controllers, const SchedulerOptions& options, bool specialize = true);
+    ~Sampler();
+
+    template <typename Device>
+    static void Loop(Sampler& sampler) {
+        sampler.Run<Device>();
+    }
+
+    bool Specialized() const {
+        return loop != &Loop<Controller>;
+    }
+
+    void Stop();
+
+    bool Pop(Sample& sample) {
+        return ring.Pop(sample);
+    }
+
+    uint64_t Dropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Misses() const {
+        return scheduler.Misses();
+    }
+
+    uint64_t Wakeups() const {
+        return wakeups.load(std::memory_order_relaxed);
+    }
+
+    bool Idle() const {
+        return idle.load(std::memory_order_relaxed);
+    }
+
+    const std::string& SetupError() const {
+        return setup_error;
+    }
+
+    const LatencyHistogram& LoopPeriod() const {
+        return loop_period;
+    }
+
+    const LatencyHistogram& PollCost() const {
+        return poll_cost;
+    }
+
+    const LatencyHistogram& WakeLatency() const {
+        return scheduler.WakeLatency();
+    }
+
+private:
+    template <typename Device>
+    void Run();
+
+    void Push(uint32_t device, const Controller::Clock::time_point& time, Controller::Action state) {
+        auto& prev_state = prev_states[device];
+        if (!ring.Push({time, state, static_cast<Controller::Action>(state ^ prev_state), device})) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        prev_state = state;
+    }
+
+    std::vector<Controller*> controllers;
+    Controller::SampleLoop loop;
+    std::vector<Controller::Action> prev_states;
+    // Each backend's poll function once, and per controller whether it is
+    // read back from its group.
+    std::vector<Controller::PollFunction> groups;
+    std::vector<bool> grouped;
+    SchedulerOptions options;
+    PollScheduler scheduler;
+    std::string setup_error;
+
+    SpscRing<Sample, 4096> ring;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> wakeups{0};
+    std::atomic<bool> idle{false};
+    LatencyHistogram loop_period;
+    LatencyHistogram poll_cost;
+
+    std::atomic<bool> running{true};
+    std::thread thread;
+};
+
+template <typename Device>
+void Sampler::Run() {
+    // Long enough to notice Stop() in time, short enough not to matter.
+    static constexpr auto IDLE_WAIT = std::chrono::milliseconds(100);
+
+    auto last_time = Controller::Clock::now();
+    auto last_input = last_time;
+    bool was_idle = false;
+    while (running.load(std::memory_order_relaxed)) {
+        const bool is_idle = idle.load(std::memory_order_relaxed);
+        Controller::Clock::time_point slot;
+        if (is_idle && controllers.size() == 1 && static_cast<Device*>(controllers[0])->WaitsForInput()) {
+            static_cast<Device*>(controllers[0])->WaitInput(IDLE_WAIT);
+            slot = Controller::Clock::now();
+        } else {
+            slot = scheduler.Wait();
+        }
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        const auto poll_time = Controller::Clock::now();
+        bool input = false;
+        for (const auto poll : groups) {
+            poll();
+        }
+        for (uint32_t device = 0; device < controllers.size(); ++device) {
+            auto* controller = static_cast<Device*>(controllers[device]);
+            const auto state = grouped[device] ? controller->PolledState() : controller->GetState();
+            Controller::Edge edge;
+            while (controller->PopEdge(edge)) {
+                Push(device, edge.time, edge.state);
+                input = true;
+            }
+            if (state != prev_states[device]) {
+                Push(device, slot, state);
+                input = true;
+            }
+        }
+        poll_cost.Record(Controller::Clock::now() - poll_time);
+
+        if (!is_idle && !was_idle) {
+            loop_period.Record(poll_time - last_time);
+        }
+        last_time = poll_time;
+        was_idle = is_idle;
+
+        if (input) {
+            last_input = poll_time;
+            if (is_idle) {
+                idle.store(false, std::memory_order_relaxed);
+                scheduler.SetPeriod(options.period);
+            }
+        } else if (!is_idle && options.idle_after.count() > 0 && poll_time - last_input > options.idle_after) {
+            idle.store(true, std::memory_order_relaxed);
+            scheduler.SetPeriod(options.idle_period);
+        }
+    }
+}
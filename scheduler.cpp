@@ -0,0 +1,107 @@
+#ifdef _WIN32
+#include <SDKDDKVer.h>
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <cerrno>
+#include <thread>
+
+#include "scheduler.h"
+
+PollScheduler::PollScheduler(const SchedulerOptions& options) : options(options) {
+}
+
+std::string PollScheduler::Configure() {
+    std::string failed;
+    const auto fail = [&](const char* step) {
+        if (!failed.empty()) {
+            failed += ", ";
+        }
+        failed += step;
+    };
+
+    // Without an explicit priority the bump is best effort and silent.
+#ifdef _WIN32
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) && options.priority > 0) {
+        fail("thread priority");
+    }
+    if (options.cpu >= 0 && SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << options.cpu) == 0) {
+        fail("CPU affinity");
+    }
+    if (options.lock_memory) {
+        fail("memory locking");
+    }
+#else
+    sched_param param{};
+    param.sched_priority = options.priority > 0 ? options.priority : sched_get_priority_min(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0 && options.priority > 0) {
+        fail("SCHED_FIFO");
+    }
+#ifdef __linux__
+    // The default 50 us timer slack would dominate the wake-up jitter.
+    prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+    if (options.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(options.cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            fail("CPU affinity");
+        }
+    }
+#else
+    if (options.cpu >= 0) {
+        fail("CPU affinity");
+    }
+#endif
+    if (options.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        fail("mlockall");
+    }
+#endif
+
+    return failed;
+}
+
+Controller::Clock::time_point PollScheduler::Wait() {
+    auto now = Controller::Clock::now();
+    if (deadline == Controller::Clock::time_point{}) {
+        deadline = now;
+    }
+
+    deadline += options.period;
+    if (now >= deadline + options.period) {
+        const auto missed = (now - deadline) / options.period;
+        misses.fetch_add(static_cast<uint64_t>(missed), std::memory_order_relaxed);
+        deadline += options.period * missed;
+    } else if (now < deadline) {
+        if (deadline - now > options.spin) {
+            SleepUntil(deadline - options.spin);
+        }
+        while ((now = Controller::Clock::now()) < deadline) {
+        }
+    }
+
+    wake_latency.Record(now - deadline);
+    return deadline;
+}
+
+void PollScheduler::SleepUntil(Controller::Clock::time_point time) {
+#ifdef __linux__
+    // The clock keeps the epoch of steady_clock, CLOCK_MONOTONIC on Linux.
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(time);
+#endif
+}
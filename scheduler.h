@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "controller.h"
+#include "histogram.h"
+
+struct SchedulerOptions {
+    std::chrono::microseconds period{500};
+    // Busy-wait tail before every deadline, absorbs the wake-up latency of
+    // the sleep at the cost of CPU time.
+    std::chrono::microseconds spin{0};
+    // SCHED_FIFO priority, 0 for a best effort minimum priority.
+    int priority = 0;
+    int cpu = -1;
+    bool lock_memory = false;
+    // Without input for idle_after, the sampler blocks on backend events
+    // where available and otherwise polls at idle_period. 0 disables.
+    std::chrono::milliseconds idle_after{2000};
+    std::chrono::microseconds idle_period{4000};
+};
+
+// Paces a polling loop on a fixed grid of absolute deadlines, so that wake
+// times do not drift with the time spent between two waits.
+class PollScheduler {
+public:
+    explicit PollScheduler(const SchedulerOptions& options);
+
+    // Applies priority, CPU affinity and memory locking to the calling
+    // thread. Returns the failed steps, empty on success.
+    std::string Configure();
+
+    // Blocks until the next deadline and returns it. Deadlines that passed
+    // while the caller was busy are skipped and counted as misses, so the
+    // returned deadline is never more than one period behind the clock.
+    Controller::Clock::time_point Wait();
+
+    std::chrono::microseconds Period() const {
+        return options.period;
+    }
+
+    // Starts a new grid at the new period, one period from the next Wait().
+    void SetPeriod(std::chrono::microseconds period) {
+        options.period = period;
+        deadline = {};
+    }
+
+    uint64_t Misses() const {
+        return misses.load(std::memory_order_relaxed);
+    }
+
+    const LatencyHistogram& WakeLatency() const {
+        return wake_latency;
+    }
+
+private:
+    void SleepUntil(Controller::Clock::time_point time);
+
+    SchedulerOptions options;
+    Controller::Clock::time_point deadline;
+    std::atomic<uint64_t> misses{0};
+    LatencyHistogram wake_latency;
+};
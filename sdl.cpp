@@ -6,12 +6,19 @@
 #include <dlfcn.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <list>
-#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "binding.h"
+#include "sampler.h"
 #include "sdl.h"
+#include "trace.h"
 
 class SDLLoader {
 public:
@@ -21,14 +28,17 @@ public:
         Free();
     }
 
-    bool Load() {
+    bool Load(bool events) {
         Free();
 
+        {
+            TraceSpan span("sdl: load library");
 #ifdef _WIN32
-        hSDL = LoadLibrary(_T("SDL2.dll"));
+            hSDL = LoadLibrary(_T("SDL2.dll"));
 #else
-        hSDL = dlopen("libSDL2.so", RTLD_LAZY);
+            hSDL = dlopen("libSDL2.so", RTLD_LAZY);
 #endif
+        }
 
         const auto& get_sym = [&](const std::string& name, auto& sym_ptr) -> bool {
 #ifdef _WIN32
@@ -39,21 +49,48 @@ public:
             return (sym_ptr = reinterpret_cast<decltype(sym_ptr)>(ptr)) != nullptr;
         };
 
-        if (hSDL == nullptr
-            || !get_sym("SDL_Init", Init)
-            || !get_sym("SDL_Quit", Quit)
-            || !get_sym("SDL_NumJoysticks", NumJoysticks)
-            || !get_sym("SDL_JoystickOpen", JoystickOpen)
-            || !get_sym("SDL_JoystickClose", JoystickClose)
-            || !get_sym("SDL_JoystickNameForIndex", JoystickNameForIndex)
-            || !get_sym("SDL_JoystickNumButtons", JoystickNumButtons)
-            || !get_sym("SDL_JoystickGetButton", JoystickGetButton)
-            || !get_sym("SDL_JoystickUpdate", JoystickUpdate)
-            || Init(SDL_INIT_JOYSTICK) != 0) {
+        bool resolved;
+        {
+            TraceSpan span("sdl: resolve symbols");
+            resolved = hSDL != nullptr
+                && get_sym("SDL_Init", Init)
+                && get_sym("SDL_Quit", Quit)
+                && get_sym("SDL_NumJoysticks", NumJoysticks)
+                && get_sym("SDL_JoystickOpen", JoystickOpen)
+                && get_sym("SDL_JoystickClose", JoystickClose)
+                && get_sym("SDL_JoystickNameForIndex", JoystickNameForIndex)
+                && get_sym("SDL_JoystickNumButtons", JoystickNumButtons)
+                && get_sym("SDL_JoystickGetButton", JoystickGetButton)
+                && get_sym("SDL_JoystickNumAxes", JoystickNumAxes)
+                && get_sym("SDL_JoystickGetAxis", JoystickGetAxis)
+                && get_sym("SDL_JoystickNumHats", JoystickNumHats)
+                && get_sym("SDL_JoystickGetHat", JoystickGetHat)
+                && get_sym("SDL_JoystickUpdate", JoystickUpdate);
+            // The event queue also carries hotplug, so it is resolved even
+            // when buttons are polled; it is only required for events.
+            const bool queue = resolved
+                && get_sym("SDL_PollEvent", PollEvent)
+                && get_sym("SDL_WaitEventTimeout", WaitEventTimeout)
+                && get_sym("SDL_JoystickInstanceID", JoystickInstanceID)
+                && get_sym("SDL_GetTicks", GetTicks);
+            resolved = resolved && (queue || !events);
+            use_events = events && queue;
+            if (resolved) {
+                get_sym("SDL_JoystickGetDeviceGUID", JoystickGetDeviceGUID);
+                get_sym("SDL_PumpEvents", PumpEvents);
+            }
+        }
+
+        if (!resolved) {
             Free();
             return false;
         }
 
+        TraceSpan span("sdl: SDL_Init");
+        if (Init(SDL_INIT_JOYSTICK) != 0) {
+            Free();
+            return false;
+        }
         return true;
     }
 
@@ -78,12 +115,95 @@ public:
         JoystickNameForIndex = nullptr;
         JoystickNumButtons = nullptr;
         JoystickGetButton = nullptr;
+        JoystickNumAxes = nullptr;
+        JoystickGetAxis = nullptr;
+        JoystickNumHats = nullptr;
+        JoystickGetHat = nullptr;
         JoystickUpdate = nullptr;
+        PollEvent = nullptr;
+        WaitEventTimeout = nullptr;
+        JoystickInstanceID = nullptr;
+        GetTicks = nullptr;
+        JoystickGetDeviceGUID = nullptr;
+        PumpEvents = nullptr;
+        use_events = false;
+    }
+
+    bool UseEvents() const {
+        return use_events;
+    }
+
+    bool Hotplug() const {
+        return JoystickInstanceID != nullptr;
     }
 
     using SDL_Joystick = void;
     static constexpr unsigned int SDL_INIT_JOYSTICK = 0x200;
 
+    static constexpr uint32_t SDL_JOYAXISMOTION = 0x600;
+    static constexpr uint32_t SDL_JOYHATMOTION = 0x602;
+    static constexpr uint32_t SDL_JOYBUTTONDOWN = 0x603;
+    static constexpr uint32_t SDL_JOYBUTTONUP = 0x604;
+    static constexpr uint32_t SDL_JOYDEVICEADDED = 0x605;
+    static constexpr uint32_t SDL_JOYDEVICEREMOVED = 0x606;
+
+    static constexpr uint8_t SDL_HAT_UP = 0x01;
+    static constexpr uint8_t SDL_HAT_RIGHT = 0x02;
+    static constexpr uint8_t SDL_HAT_DOWN = 0x04;
+    static constexpr uint8_t SDL_HAT_LEFT = 0x08;
+
+    struct SDL_JoyAxisEvent {
+        uint32_t type;
+        uint32_t timestamp;
+        int32_t which;
+        uint8_t axis;
+        uint8_t padding1;
+        uint8_t padding2;
+        uint8_t padding3;
+        int16_t value;
+        uint16_t padding4;
+    };
+
+    struct SDL_JoyHatEvent {
+        uint32_t type;
+        uint32_t timestamp;
+        int32_t which;
+        uint8_t hat;
+        uint8_t value;
+        uint8_t padding1;
+        uint8_t padding2;
+    };
+
+    struct SDL_JoyButtonEvent {
+        uint32_t type;
+        uint32_t timestamp;
+        int32_t which;
+        uint8_t button;
+        uint8_t state;
+        uint8_t padding1;
+        uint8_t padding2;
+    };
+
+    // Added events carry the device index, removed ones the instance id.
+    struct SDL_JoyDeviceEvent {
+        uint32_t type;
+        uint32_t timestamp;
+        int32_t which;
+    };
+
+    struct SDL_JoystickGUID {
+        uint8_t data[16];
+    };
+
+    union SDL_Event {
+        uint32_t type;
+        SDL_JoyAxisEvent jaxis;
+        SDL_JoyHatEvent jhat;
+        SDL_JoyButtonEvent jbutton;
+        SDL_JoyDeviceEvent jdevice;
+        uint8_t padding[64];
+    };
+
     int (*Init)(unsigned int) = nullptr;
     int (*Quit)() = nullptr;
     int (*NumJoysticks)() = nullptr;
@@ -92,7 +212,17 @@ public:
     const char* (*JoystickNameForIndex)(int) = nullptr;
     int (*JoystickNumButtons)(SDL_Joystick*) = nullptr;
     unsigned char (*JoystickGetButton)(SDL_Joystick*, int) = nullptr;
+    int (*JoystickNumAxes)(SDL_Joystick*) = nullptr;
+    int16_t (*JoystickGetAxis)(SDL_Joystick*, int) = nullptr;
+    int (*JoystickNumHats)(SDL_Joystick*) = nullptr;
+    uint8_t (*JoystickGetHat)(SDL_Joystick*, int) = nullptr;
     int (*JoystickUpdate)() = nullptr;
+    int (*PollEvent)(SDL_Event*) = nullptr;
+    int (*WaitEventTimeout)(SDL_Event*, int) = nullptr;
+    int32_t (*JoystickInstanceID)(SDL_Joystick*) = nullptr;
+    uint32_t (*GetTicks)() = nullptr;
+    SDL_JoystickGUID (*JoystickGetDeviceGUID)(int) = nullptr;
+    void (*PumpEvents)() = nullptr;
 
 private:
 #ifdef _WIN32
@@ -100,6 +230,7 @@ private:
 #else
     void* hSDL = nullptr;
 #endif
+    bool use_events = false;
 };
 
 std::unique_ptr<SDLLoader> sdl;
@@ -107,9 +238,9 @@ std::unique_ptr<SDLLoader> sdl;
 class SDLController;
 static std::list<std::unique_ptr<SDLController>> controllers;
 
-bool sdl_init() {
+bool sdl_init(bool use_events) {
     sdl = std::make_unique<SDLLoader>();
-    if (sdl != nullptr && sdl->Load()) {
+    if (sdl != nullptr && sdl->Load(use_events)) {
         return true;
     }
     sdl.reset();
@@ -121,6 +252,12 @@ void sdl_exit() {
     sdl.reset();
 }
 
+void sdl_pump() {
+    if (sdl != nullptr && sdl->PumpEvents != nullptr) {
+        sdl->PumpEvents();
+    }
+}
+
 void sdl_enum(const sdl_enum_cb& callback) {
     if (sdl == nullptr) {
         return;
@@ -132,46 +269,381 @@ void sdl_enum(const sdl_enum_cb& callback) {
     }
 }
 
+std::string sdl_guid(int index) {
+    if (sdl == nullptr || sdl->JoystickGetDeviceGUID == nullptr) {
+        return "";
+    }
+
+    static const char digits[] = "0123456789abcdef";
+    const auto guid = sdl->JoystickGetDeviceGUID(index);
+    std::string res;
+    for (const auto byte : guid.data) {
+        res += digits[byte >> 4];
+        res += digits[byte & 0xf];
+    }
+    return res;
+}
+
+// Open controllers whose device is unplugged.
+static int missing = 0;
+
 class SDLController final : public Controller {
 public:
-    SDLController(int index) : Controller() {
-        joystick = sdl->JoystickOpen(index);
-        buttons = sdl->JoystickNumButtons(joystick);
+    SDLController(int index) : Controller(), guid(sdl_guid(index)), name(DeviceName(index)) {
+        Open(index);
     }
 
     ~SDLController() {
-        sdl->JoystickClose(joystick);
+        if (joystick != nullptr) {
+            sdl->JoystickClose(joystick);
+        } else if (lost) {
+            --missing;
+        }
     }
 
     std::string BindAction(Action action) override {
-        sdl->JoystickUpdate();
+        Update();
+        edges.clear();
+        if (joystick == nullptr) {
+            return "";
+        }
         for (int i = 0; i < buttons; ++i) {
             if (sdl->JoystickGetButton(joystick, i)) {
-                bindings[action] = i;
+                bindings.Set(action, i);
+                axis_bindings.Clear(action);
+                state = Evaluate();
                 return "Button " + std::to_string(i);
             }
         }
+
+        for (size_t i = 0; i < axes.size(); ++i) {
+            axes[i] = ReadAxis(static_cast<int>(i));
+        }
+        const int code = AxisBindings::Detect(axes.data(), rest.data(), axes.size(), threshold);
+        if (code >= 0) {
+            bindings.Clear(action);
+            axis_bindings.Set(action, code);
+            state = Evaluate();
+            return AxisName(code);
+        }
         return "";
     }
 
+    int GetBinding(Action action) const override {
+        const int button = bindings.Find(action);
+        return button >= 0 ? button : axis_bindings.Find(action);
+    }
+
+    bool SetBinding(Action action, int code) override {
+        if (AxisBindings::IsCode(code)) {
+            if (static_cast<size_t>(AxisBindings::Axis(code)) >= axes.size()) {
+                return false;
+            }
+            bindings.Clear(action);
+            axis_bindings.Set(action, code);
+        } else {
+            if (code < 0 || code >= buttons) {
+                return false;
+            }
+            bindings.Set(action, code);
+            axis_bindings.Clear(action);
+        }
+        state = Evaluate();
+        return true;
+    }
+
+    void SetAxisThreshold(const AxisThreshold& new_threshold) override {
+        threshold = new_threshold;
+        axis_bindings.SetThreshold(threshold);
+    }
+
     Action GetState() override {
-        sdl->JoystickUpdate();
-        Action res{};
-        for (auto& pair : bindings) {
-            if (sdl->JoystickGetButton(joystick, pair.second)) {
-                res = static_cast<Action>(res | pair.first);
+        Update();
+        Refresh();
+        return state;
+    }
+
+    PollFunction PollGroup() const override {
+        return &SDLController::Poll;
+    }
+
+    Action PolledState() const override {
+        return state;
+    }
+
+    SampleLoop Loop() const override {
+        return &Sampler::Loop<SDLController>;
+    }
+
+    bool PopEdge(Edge& edge) override {
+        if (edges.empty()) {
+            return false;
+        }
+        edge = edges.front();
+        edges.pop_front();
+        return true;
+    }
+
+    void WaitInput(std::chrono::microseconds timeout) override {
+        const auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+        if (sdl->UseEvents() && timeout_ms > 0) {
+            sdl->WaitEventTimeout(nullptr, static_cast<int>(timeout_ms));
+        } else {
+            Controller::WaitInput(timeout);
+        }
+    }
+
+    bool WaitsForInput() const override {
+        return sdl->UseEvents();
+    }
+
+    bool Attached() const override {
+        return attached;
+    }
+
+    void OnButton(const SDLLoader::SDL_JoyButtonEvent& event, Clock::time_point time) {
+        if (joystick == nullptr || event.which != instance_id || event.button >= pressed.size()) {
+            return;
+        }
+
+        pressed[event.button] = event.type == SDLLoader::SDL_JOYBUTTONDOWN;
+        Changed(time);
+    }
+
+    void OnAxis(const SDLLoader::SDL_JoyAxisEvent& event, Clock::time_point time) {
+        if (joystick == nullptr || event.which != instance_id || event.axis >= axis_count) {
+            return;
+        }
+
+        axes[event.axis] = event.value;
+        if (!axis_bindings.Empty()) {
+            Changed(time);
+        }
+    }
+
+    void OnHat(const SDLLoader::SDL_JoyHatEvent& event, Clock::time_point time) {
+        if (joystick == nullptr || event.which != instance_id || event.hat >= hat_count) {
+            return;
+        }
+
+        const size_t axis = static_cast<size_t>(axis_count) + 2 * event.hat;
+        axes[axis] = HatAxis(event.value, SDLLoader::SDL_HAT_LEFT, SDLLoader::SDL_HAT_RIGHT);
+        axes[axis + 1] = HatAxis(event.value, SDLLoader::SDL_HAT_UP, SDLLoader::SDL_HAT_DOWN);
+        if (!axis_bindings.Empty()) {
+            Changed(time);
+        }
+    }
+
+    void OnRemoved(int32_t which, Clock::time_point time) {
+        if (joystick == nullptr || which != instance_id) {
+            return;
+        }
+
+        sdl->JoystickClose(joystick);
+        joystick = nullptr;
+        attached = false;
+        lost = true;
+        ++missing;
+        std::fill(pressed.begin(), pressed.end(), 0);
+        if (state != Action{}) {
+            state = {};
+            edges.push_back({time, state});
+        }
+    }
+
+    // Takes a newly added device back when it is the one this controller
+    // lost; bindings are kept as they were.
+    bool Reattach(int index) {
+        if (joystick != nullptr || sdl_guid(index) != guid || DeviceName(index) != name) {
+            return false;
+        }
+        Open(index);
+        if (joystick == nullptr) {
+            return false;
+        }
+        lost = false;
+        --missing;
+        return true;
+    }
+
+private:
+    static void Update();
+
+    // One update and event drain for every open joystick.
+    static void Poll() {
+        Update();
+        for (auto& controller : controllers) {
+            controller->Refresh();
+        }
+    }
+
+    // Polled joysticks read their buttons into the state events keep. Axes
+    // are only read when something is bound to them.
+    void Refresh() {
+        if (!sdl->UseEvents() && joystick != nullptr) {
+            state = bindings.Evaluate([&](int button) {
+                return sdl->JoystickGetButton(joystick, button);
+            });
+            if (!axis_bindings.Empty()) {
+                state = static_cast<Action>(state | axis_bindings.Evaluate([&](int axis) {
+                    return ReadAxis(axis);
+                }));
             }
         }
+    }
+
+    // Hats are read as two axes each, after the real axes.
+    static int16_t HatAxis(uint8_t hat, uint8_t negative, uint8_t positive) {
+        return (hat & positive) ? 32767 : (hat & negative) ? -32768 : 0;
+    }
 
+    int16_t ReadAxis(int axis) const {
+        if (axis < axis_count) {
+            return sdl->JoystickGetAxis(joystick, axis);
+        }
+        const int hat = (axis - axis_count) / 2;
+        const auto value = sdl->JoystickGetHat(joystick, hat);
+        return (axis - axis_count) % 2 == 0
+            ? HatAxis(value, SDLLoader::SDL_HAT_LEFT, SDLLoader::SDL_HAT_RIGHT)
+            : HatAxis(value, SDLLoader::SDL_HAT_UP, SDLLoader::SDL_HAT_DOWN);
+    }
+
+    std::string AxisName(int code) const {
+        const int axis = AxisBindings::Axis(code);
+        if (axis < axis_count) {
+            return AxisBindings::Name(code);
+        }
+        static const char* const directions[] = {"Right", "Left", "Down", "Up"};
+        return "Hat " + std::to_string((axis - axis_count) / 2) + " "
+            + directions[((axis - axis_count) % 2) * 2 + (code & 1)];
+    }
+
+    void Changed(Clock::time_point time) {
+        const auto new_state = Evaluate();
+        if (new_state != state) {
+            state = new_state;
+            edges.push_back({time, state});
+        }
+    }
+
+    static std::string DeviceName(int index) {
+        const char* name = sdl->JoystickNameForIndex(index);
+        return name != nullptr ? name : "";
+    }
+
+    void Open(int index) {
+        joystick = sdl->JoystickOpen(index);
+        buttons = joystick != nullptr ? sdl->JoystickNumButtons(joystick) : 0;
+        axis_count = joystick != nullptr ? std::max(sdl->JoystickNumAxes(joystick), 0) : 0;
+        hat_count = joystick != nullptr ? std::max(sdl->JoystickNumHats(joystick), 0) : 0;
+        // Whatever the axes read when opened is taken as their rest.
+        axes.resize(static_cast<size_t>(axis_count + 2 * hat_count));
+        for (size_t i = 0; i < axes.size(); ++i) {
+            axes[i] = ReadAxis(static_cast<int>(i));
+        }
+        rest = axes;
+        if (joystick != nullptr && sdl->Hotplug()) {
+            instance_id = sdl->JoystickInstanceID(joystick);
+        }
+        if (sdl->UseEvents()) {
+            pressed.assign(static_cast<size_t>(std::max(buttons, 0)), 0);
+        }
+        attached = joystick != nullptr;
+    }
+
+    Action Evaluate() {
+        auto res = bindings.Evaluate(pressed.data(), pressed.size());
+        if (!axis_bindings.Empty()) {
+            res = static_cast<Action>(res | axis_bindings.Evaluate(axes.data(), axes.size()));
+        }
         return res;
     }
 
-private:
-    std::map<Action, int> bindings;
+    ButtonBindings bindings;
+    AxisBindings axis_bindings;
+    AxisThreshold threshold;
     SDLLoader::SDL_Joystick* joystick = nullptr;
     int buttons = 0;
+    int axis_count = 0;
+    int hat_count = 0;
+    std::vector<int16_t> axes;
+    std::vector<int16_t> rest;
+    const std::string guid;
+    const std::string name;
+    std::atomic<bool> attached{false};
+    bool lost = false;
+
+    int32_t instance_id = -1;
+    std::vector<unsigned char> pressed;
+    std::deque<Edge> edges;
+    Action state{};
 };
 
+// Polls between two looks at the device events when buttons are polled.
+static constexpr unsigned int HOTPLUG_POLLS = 128;
+static unsigned int hotplug_polls = 0;
+
+void SDLController::Update() {
+    if (!sdl->UseEvents()) {
+        sdl->JoystickUpdate();
+
+        // Polled buttons leave the queue for device events only. It is
+        // drained every so many polls, which keeps the clock out of the hot
+        // path, and on every poll while a device is missing so it comes back
+        // as soon as it is plugged in.
+        if (!sdl->Hotplug() || (++hotplug_polls % HOTPLUG_POLLS != 0 && missing == 0)) {
+            return;
+        }
+    }
+
+    // SDL stamps events in whole milliseconds when they are pumped; events
+    // pumped by this very call are stamped with the current time instead,
+    // older ones are backdated by the age SDL reports for them.
+    const auto now = Clock::now();
+    const auto ticks = sdl->GetTicks();
+    SDLLoader::SDL_Event event;
+    while (sdl->PollEvent(&event)) {
+        const auto age = std::chrono::milliseconds(static_cast<int32_t>(ticks - event.jbutton.timestamp));
+        const auto time = age.count() > 0 ? now - age : now;
+        switch (event.type) {
+        case SDLLoader::SDL_JOYBUTTONDOWN:
+        case SDLLoader::SDL_JOYBUTTONUP:
+            if (sdl->UseEvents()) {
+                for (auto& controller : controllers) {
+                    controller->OnButton(event.jbutton, time);
+                }
+            }
+            break;
+        case SDLLoader::SDL_JOYAXISMOTION:
+            if (sdl->UseEvents()) {
+                for (auto& controller : controllers) {
+                    controller->OnAxis(event.jaxis, time);
+                }
+            }
+            break;
+        case SDLLoader::SDL_JOYHATMOTION:
+            if (sdl->UseEvents()) {
+                for (auto& controller : controllers) {
+                    controller->OnHat(event.jhat, time);
+                }
+            }
+            break;
+        case SDLLoader::SDL_JOYDEVICEADDED:
+            for (auto& controller : controllers) {
+                if (controller->Reattach(event.jdevice.which)) {
+                    break;
+                }
+            }
+            break;
+        case SDLLoader::SDL_JOYDEVICEREMOVED:
+            for (auto& controller : controllers) {
+                controller->OnRemoved(event.jdevice.which, time);
+            }
+            break;
+        }
+    }
+}
+
 Controller* sdl_open(int index) {
     if (sdl == nullptr) {
         return nullptr;
@@ -5,12 +5,22 @@
 
 #include "controller.h"
 
-bool sdl_init();
+bool sdl_init(bool use_events = false);
 void sdl_exit();
 
+// Pumps SDL's events on the thread that called sdl_init(). On Windows the
+// device-notification window SDL_Init() creates only gets its messages
+// dispatched there, so hotplug is noticed only when that thread pumps. What
+// it pumps lands in SDL's queue, which the sampler drains.
+void sdl_pump();
+
 using sdl_enum_cb = std::function<void(int index, const std::string & name)>;
 void sdl_enum(const sdl_enum_cb& callback);
 
+// Hex form of the joystick GUID, the same for every device of a model.
+// Empty when the library does not provide it.
+std::string sdl_guid(int index);
+
 Controller* sdl_open(int index);
 
 void sdl_close(const Controller* controller);
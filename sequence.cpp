@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "replay.h"
+#include "sequence.h"
+
+bool SequenceRecognizer::Compile(std::vector<SequencePattern> new_patterns) {
+    // Every distinct chord gets an index; an input class is the set of
+    // chords its inputs take.
+    std::vector<Controller::Action> chords;
+    std::vector<std::vector<uint32_t>> pattern_chords;
+    uint32_t used = 0;
+    for (const auto& pattern : new_patterns) {
+        if (pattern.steps.empty() || pattern.steps.size() > MAX_STEPS || pattern.tables.size() != pattern.steps.size()) {
+            return false;
+        }
+        auto& indices = pattern_chords.emplace_back();
+        for (const auto step : pattern.steps) {
+            auto chord = std::find(chords.begin(), chords.end(), step);
+            if (chord == chords.end()) {
+                chord = chords.insert(chords.end(), step);
+            }
+            indices.push_back(static_cast<uint32_t>(chord - chords.begin()));
+            used |= step;
+        }
+    }
+
+    std::map<std::vector<bool>, uint16_t> class_ids;
+    std::vector<std::vector<bool>> class_chords(1);
+    classes.fill(0);
+    for (uint32_t pressed = 1; pressed < ACTION_STATES; ++pressed) {
+        if ((pressed & used) == 0) {
+            continue;
+        }
+        for (uint32_t held = pressed; held < ACTION_STATES; ++held) {
+            if ((held & pressed) != pressed) {
+                continue;
+            }
+            std::vector<bool> taken(chords.size());
+            for (size_t i = 0; i < chords.size(); ++i) {
+                taken[i] = (held & chords[i]) == static_cast<uint32_t>(chords[i]) && (pressed & chords[i]) != 0;
+            }
+            const auto inserted = class_ids.emplace(taken, static_cast<uint16_t>(class_chords.size()));
+            if (inserted.second) {
+                class_chords.push_back(taken);
+            }
+            classes[pressed * ACTION_STATES + held] = inserted.first->second;
+        }
+    }
+    class_count = static_cast<uint32_t>(class_chords.size());
+
+    // Subset construction over (pattern, steps matched) pairs. Completed
+    // pairs stay in their state so that entering it reports them.
+    using Prefixes = std::vector<std::pair<uint32_t, uint32_t>>;
+    std::map<Prefixes, uint16_t> state_ids{{{}, 0}};
+    std::vector<Prefixes> states(1);
+    std::vector<uint16_t> new_transitions;
+    for (size_t state = 0; state < states.size(); ++state) {
+        const auto current = states[state];
+        new_transitions.push_back(static_cast<uint16_t>(state));
+        for (uint32_t input = 1; input < class_count; ++input) {
+            Prefixes next;
+            const auto advance = [&](uint32_t pattern, uint32_t matched) {
+                if (class_chords[input][pattern_chords[pattern][matched]]) {
+                    next.emplace_back(pattern, matched + 1);
+                }
+            };
+            for (uint32_t pattern = 0; pattern < new_patterns.size(); ++pattern) {
+                advance(pattern, 0);
+            }
+            for (const auto& prefix : current) {
+                if (prefix.second < new_patterns[prefix.first].steps.size()) {
+                    advance(prefix.first, prefix.second);
+                }
+            }
+            std::sort(next.begin(), next.end());
+            next.erase(std::unique(next.begin(), next.end()), next.end());
+
+            const auto inserted = state_ids.emplace(next, static_cast<uint16_t>(states.size()));
+            if (inserted.second) {
+                if (states.size() == MAX_STATES) {
+                    return false;
+                }
+                states.push_back(std::move(next));
+            }
+            new_transitions.push_back(inserted.first->second);
+        }
+    }
+
+    outputs_begin.assign(1, 0);
+    outputs.clear();
+    for (const auto& prefixes : states) {
+        for (const auto& prefix : prefixes) {
+            if (prefix.second == new_patterns[prefix.first].steps.size()) {
+                outputs.push_back(prefix.first);
+            }
+        }
+        outputs_begin.push_back(static_cast<uint32_t>(outputs.size()));
+    }
+    transitions = std::move(new_transitions);
+    patterns = std::move(new_patterns);
+    return true;
+}
+
+bool sequence_load_rules(const std::string& path, unsigned int rate, SequenceRecognizer& recognizer) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    const auto frame = std::chrono::duration<double, std::nano>(1e9 / rate);
+    std::vector<SequencePattern> patterns;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream stream(line);
+        std::string keyword;
+        if (!(stream >> keyword) || keyword != "sequence") {
+            continue;
+        }
+
+        SequencePattern pattern;
+        std::vector<std::string> tokens;
+        if (!(stream >> pattern.name)) {
+            return false;
+        }
+        for (std::string token; stream >> token;) {
+            tokens.push_back(token);
+        }
+
+        size_t next = 0;
+        double timeout_frames = 60;
+        if (tokens.size() >= 2 && tokens[0] == "timeout") {
+            std::stringstream timeout(tokens[1]);
+            if (!(timeout >> timeout_frames) || timeout_frames <= 0) {
+                return false;
+            }
+            next = 2;
+        }
+        pattern.timeout = std::chrono::duration_cast<Controller::Clock::duration>(frame * timeout_frames);
+
+        // Anything that does not name buttons grades the step before it.
+        std::vector<std::vector<std::string>> grades;
+        for (; next < tokens.size(); ++next) {
+            Controller::Action step;
+            if (parse_actions(tokens[next], step) && step != 0) {
+                pattern.steps.push_back(step);
+                pattern.step_names.push_back(tokens[next]);
+                grades.emplace_back();
+            } else if (grades.size() > 1) {
+                grades.back().push_back(tokens[next]);
+            } else {
+                return false;
+            }
+        }
+        if (pattern.steps.empty() || pattern.steps.size() > SequenceRecognizer::MAX_STEPS) {
+            return false;
+        }
+
+        pattern.tables.emplace_back();
+        for (size_t step = 1; step < grades.size(); ++step) {
+            std::vector<GradeStep> steps{{Grade::Green, 0, false}};
+            if (!grades[step].empty() && !parse_grade_steps(grades[step], steps)) {
+                return false;
+            }
+            pattern.tables.emplace_back(steps.data(), steps.size(), rate);
+        }
+        patterns.push_back(std::move(pattern));
+    }
+
+    return recognizer.Compile(std::move(patterns));
+}
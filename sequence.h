@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "controller.h"
+#include "grading.h"
+
+// A timed run of presses, e.g. a dash cancelled into a slash. Every step
+// is a chord, taken by a press of one of its buttons while all of them are
+// held: "Dash" is a plain press, "Dash+Slash" the press that completes the
+// pair. Steps after the first are graded by the time since the step before
+// and must come within `timeout` of it.
+struct SequencePattern {
+    std::string name;
+    std::vector<Controller::Action> steps;
+    std::vector<std::string> step_names;
+    // One per step, the first is never used.
+    std::vector<GradeTable> tables;
+    Controller::Clock::duration timeout;
+};
+
+// A device's position in the recognizer: its automaton state and the times
+// of its latest presses that counted.
+struct SequenceCursor {
+    static constexpr size_t MAX_STEPS = 8;
+
+    uint32_t state = 0;
+    uint32_t count = 0;
+    std::array<Controller::Clock::time_point, MAX_STEPS> times{};
+};
+
+// Every pattern compiled together into one deterministic automaton, so a
+// press costs two table lookups however many patterns there are. The
+// presses of one sample make one input. Inputs are grouped into classes
+// by the steps they would take, and each automaton state is the set of
+// pattern prefixes the latest inputs match. Presses of buttons no pattern
+// uses are ignored; any other press that continues no pattern breaks
+// them all.
+class SequenceRecognizer {
+public:
+    static constexpr size_t MAX_STEPS = SequenceCursor::MAX_STEPS;
+    static constexpr size_t MAX_STATES = 4096;
+
+    // False when a pattern has no steps or too many, or when the automaton
+    // would need more than MAX_STATES states.
+    bool Compile(std::vector<SequencePattern> new_patterns);
+
+    bool Empty() const {
+        return patterns.empty();
+    }
+
+    const std::vector<SequencePattern>& Patterns() const {
+        return patterns;
+    }
+
+    size_t States() const {
+        return outputs_begin.size() - 1;
+    }
+
+    // Feeds the presses of one sample and calls fn(index, times) for every
+    // pattern completed in time, with `times` holding one time per step.
+    template <typename Fn>
+    void Press(SequenceCursor& cursor, Controller::Action pressed, Controller::Action held, Controller::Clock::time_point time,
+        Fn&& fn) const {
+        const auto input = classes[(pressed & ACTION_MASK) * ACTION_STATES + (held & ACTION_MASK)];
+        if (input == 0) {
+            return;
+        }
+
+        cursor.state = transitions[cursor.state * class_count + input];
+        cursor.times[cursor.count++ % MAX_STEPS] = time;
+
+        for (auto i = outputs_begin[cursor.state]; i < outputs_begin[cursor.state + 1]; ++i) {
+            const auto& pattern = patterns[outputs[i]];
+            const auto length = static_cast<uint32_t>(pattern.steps.size());
+            std::array<Controller::Clock::time_point, MAX_STEPS> times;
+            bool in_time = true;
+            for (uint32_t step = 0; step < length; ++step) {
+                times[step] = cursor.times[(cursor.count - length + step) % MAX_STEPS];
+                if (step > 0 && times[step] - times[step - 1] > pattern.timeout) {
+                    in_time = false;
+                }
+            }
+            if (in_time) {
+                fn(outputs[i], times.data());
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t ACTION_STATES = 64;
+    static constexpr uint32_t ACTION_MASK = ACTION_STATES - 1;
+
+    std::vector<SequencePattern> patterns;
+
+    // Input class of every (pressed, held) pair, 0 for ignored presses.
+    std::array<uint16_t, ACTION_STATES * ACTION_STATES> classes{};
+    uint32_t class_count = 1;
+    std::vector<uint16_t> transitions;
+    // Patterns completed on entering a state.
+    std::vector<uint32_t> outputs_begin{0, 0};
+    std::vector<uint32_t> outputs;
+};
+
+// Reads the "sequence" lines of a rule file, graded at `rate`: a name, an
+// optional timeout in frames (60 by default), then the steps, each but the
+// first followed by the grade steps of its interval as in a technique
+// rule; without them any interval within the timeout is green.
+//   sequence cancel Dash Slash green 0 yellow 6 red 10
+//   sequence pogo timeout 20 Slash Dash red 0 green 3 red 8
+bool sequence_load_rules(const std::string& path, unsigned int rate, SequenceRecognizer& recognizer);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Wait-free single-producer/single-consumer ring. Push() fails instead of
+// blocking when the consumer has fallen a full ring behind.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool Push(const T& item) {
+        const auto head = write_index.load(std::memory_order_relaxed);
+        if (head - read_cache >= Capacity) {
+            read_cache = read_index.load(std::memory_order_acquire);
+            if (head - read_cache >= Capacity) {
+                return false;
+            }
+        }
+
+        items[head & (Capacity - 1)] = item;
+        write_index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item) {
+        const auto tail = read_index.load(std::memory_order_relaxed);
+        if (tail == write_cache) {
+            write_cache = write_index.load(std::memory_order_acquire);
+            if (tail == write_cache) {
+                return false;
+            }
+        }
+
+        item = items[tail & (Capacity - 1)];
+        read_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> items{};
+
+    alignas(64) std::atomic<size_t> write_index{0};
+    size_t read_cache = 0;
+
+    alignas(64) std::atomic<size_t> read_index{0};
+    size_t write_cache = 0;
+};
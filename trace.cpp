@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+namespace {
+
+struct Span {
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    unsigned int thread;
+};
+
+// Dynamic initialization runs before main(), close enough to process start.
+const auto origin = std::chrono::steady_clock::now();
+
+std::mutex mutex;
+std::vector<Span> spans;
+std::atomic<unsigned int> next_thread{0};
+
+unsigned int thread_number() {
+    thread_local const unsigned int number = next_thread.fetch_add(1);
+    return number;
+}
+
+// Numbers the main thread 0.
+const auto main_thread = thread_number();
+
+}
+
+void trace_record(const char* name, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end) {
+    const auto thread = thread_number();
+    std::lock_guard<std::mutex> lock(mutex);
+    spans.push_back({name, start, end, thread});
+}
+
+void trace_print(std::FILE* file) {
+    std::vector<Span> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted = spans;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Span& a, const Span& b) {
+        return a.start < b.start;
+    });
+
+    const auto ms = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    std::fprintf(file, "%-24s %9s %9s %9s %s\n", "startup", "start ms", "end ms", "took ms", "thread");
+    for (const auto& span : sorted) {
+        std::fprintf(file, "%-24s %9.2f %9.2f %9.2f %u\n", span.name,
+            ms(span.start - origin), ms(span.end - origin), ms(span.end - span.start), span.thread);
+    }
+}
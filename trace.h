@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// Startup phases, timed from process start and collected from any thread.
+// Spans nest by time only; they are meant for a one-off trace, not for hot
+// paths.
+void trace_record(const char* name, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end);
+void trace_print(std::FILE* file);
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name(name), start(std::chrono::steady_clock::now()) {}
+
+    ~TraceSpan() {
+        trace_record(name, start, std::chrono::steady_clock::now());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+};
@@ -7,11 +7,14 @@
 #define AXIS_MIN -32768
 #define AXIS_MAX 32767
 
+#include <iterator>
 #include <list>
 #include <map>
 #include <memory>
 #include <string>
 
+#include "binding.h"
+#include "sampler.h"
 #include "xinput.h"
 
 class XInputLoader {
@@ -172,6 +175,20 @@ static const std::map<WORD, std::string_view> XINPUT_BUTTONS{
     {XINPUT_GAMEPAD_GUIDE, "Guide"}
 };
 
+// Sticks as they are, triggers stretched over the int16 range so they rest
+// at -32768 like SDL reports them.
+static const char* const XINPUT_AXES[] = {"LX", "LY", "RX", "RY", "LT", "RT"};
+static constexpr int16_t XINPUT_AXES_REST[] = {0, 0, 0, 0, -32768, -32768};
+
+static void xinput_axes(const XINPUT_GAMEPAD& gamepad, int16_t* axes) {
+    axes[0] = gamepad.sThumbLX;
+    axes[1] = gamepad.sThumbLY;
+    axes[2] = gamepad.sThumbRX;
+    axes[3] = gamepad.sThumbRY;
+    axes[4] = static_cast<int16_t>(gamepad.bLeftTrigger * 257 - 32768);
+    axes[5] = static_cast<int16_t>(gamepad.bRightTrigger * 257 - 32768);
+}
+
 class XInputController final : public Controller {
 public:
     XInputController(DWORD dwIndex) : Controller(), id(dwIndex) {}
@@ -182,31 +199,94 @@ public:
         if (xinput->GetState(id, &state) == ERROR_SUCCESS) {
             for (auto& pair : XINPUT_BUTTONS) {
                 if (state.Gamepad.wButtons & pair.first) {
-                    bindings[action] = pair.first;
+                    bindings.Set(action, pair.first);
+                    axis_bindings.Clear(action);
                     return std::string(pair.second);
                 }
             }
+
+            int16_t axes[std::size(XINPUT_AXES)];
+            xinput_axes(state.Gamepad, axes);
+            const int code = AxisBindings::Detect(axes, XINPUT_AXES_REST, std::size(axes), threshold);
+            if (code >= 0) {
+                bindings.Clear(action);
+                axis_bindings.Set(action, code);
+                const int axis = AxisBindings::Axis(code);
+                return std::string(XINPUT_AXES[axis]) + (axis >= 4 ? "" : (code & 1) ? "-" : "+");
+            }
         }
         return "";
     }
 
-    Action GetState() override {
-        Action res{};
-        XINPUT_STATE state;
-        if (xinput->GetState(id, &state) == ERROR_SUCCESS) {
-            for (auto& pair : bindings) {
-                if (state.Gamepad.wButtons & pair.second) {
-                    res = static_cast<Action>(res | pair.first);
-                }
+    int GetBinding(Action action) const override {
+        const auto buttons = bindings.Find(action);
+        return buttons != 0 ? buttons : axis_bindings.Find(action);
+    }
+
+    bool SetBinding(Action action, int code) override {
+        if (AxisBindings::IsCode(code)) {
+            if (static_cast<size_t>(AxisBindings::Axis(code)) >= std::size(XINPUT_AXES)) {
+                return false;
             }
+            bindings.Clear(action);
+            axis_bindings.Set(action, code);
+            return true;
+        }
+        if (code <= 0 || code > 0xffff) {
+            return false;
         }
+        bindings.Set(action, static_cast<uint16_t>(code));
+        axis_bindings.Clear(action);
+        return true;
+    }
 
-        return res;
+    void SetAxisThreshold(const AxisThreshold& new_threshold) override {
+        threshold = new_threshold;
+        axis_bindings.SetThreshold(threshold);
+    }
+
+    Action GetState() override {
+        Refresh();
+        return state;
+    }
+
+    PollFunction PollGroup() const override {
+        return [] {
+            for (auto& controller : controllers) {
+                controller->Refresh();
+            }
+        };
+    }
+
+    Action PolledState() const override {
+        return state;
+    }
+
+    SampleLoop Loop() const override {
+        return &Sampler::Loop<XInputController>;
     }
 
 private:
-    std::map<Action, WORD> bindings;
+    void Refresh() {
+        XINPUT_STATE xstate;
+        if (xinput->GetState(id, &xstate) != ERROR_SUCCESS) {
+            state = {};
+            return;
+        }
+
+        state = bindings.Evaluate(xstate.Gamepad.wButtons);
+        if (!axis_bindings.Empty()) {
+            int16_t axes[std::size(XINPUT_AXES)];
+            xinput_axes(xstate.Gamepad, axes);
+            state = static_cast<Action>(state | axis_bindings.Evaluate(axes, std::size(axes)));
+        }
+    }
+
+    MaskBindings bindings;
+    AxisBindings axis_bindings;
+    AxisThreshold threshold;
     DWORD id;
+    Action state{};
 };
 
 Controller* xinput_open(DWORD dwIndex) {